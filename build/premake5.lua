@@ -43,6 +43,19 @@ newoption
     default = "off"
 }
 
+newoption
+{
+    trigger = "dispatch",
+    value = "DISPATCH",
+    description = "interpreter core new libchip8 instances start with",
+    allowed = {
+        { "switch", "Nested switch"},
+        { "table", "64K-entry opcode table"},
+        { "threaded", "Threaded code (computed goto, GCC/Clang only)"},
+    },
+    default = "switch"
+}
+
 function download_progress(total, current)
     local ratio = current / total;
     ratio = math.min(math.max(ratio, 0), 1);
@@ -197,6 +210,9 @@ if (downloadRaylib) then
         }
         
         files {"../src/**.c", "../src/**.cpp", "../src/**.h", "../src/**.hpp", "../include/**.h", "../include/**.hpp"}
+
+        -- the emulator core comes from the chip8 library project below
+        removefiles {"../src/chip8/**"}
         
         filter {"system:windows", "action:vs*"}
             files {"../src/*.rc", "../src/*.ico"}
@@ -210,7 +226,7 @@ if (downloadRaylib) then
         includedirs { "../include/**" }
         
 
-        links {"raylib"}
+        links {"chip8", "raylib"}
 
         cdialect "C17"
         cppdialect "C++17"
@@ -222,7 +238,7 @@ if (downloadRaylib) then
 
         filter "action:vs*"
             defines{"_WINSOCK_DEPRECATED_NO_WARNINGS", "_CRT_SECURE_NO_WARNINGS"}
-            dependson {"raylib"}
+            dependson {"chip8", "raylib"}
             links {"raylib.lib"}
             characterset ("Unicode")
             buildoptions { "/Zc:__cplusplus" }
@@ -307,3 +323,90 @@ if (downloadRaylib) then
             compileas "Objective-C"
 
         filter{}
+
+
+    -- Headless emulator core. Only needs the C runtime, so batch workers and tools can link it
+    -- without raylib, GLFW, X11 or an audio device.
+    function chip8_library()
+        location "build_files/"
+
+        language "C"
+        cdialect "C17"
+
+        vpaths
+        {
+            ["Header Files/*"] = { "../include/chip8/**.h", "../src/chip8/**.h"},
+            ["Source Files/*"] = { "../src/chip8/**.c"},
+        }
+        files {"../include/chip8/**.h", "../src/chip8/**.h", "../src/chip8/**.c"}
+
+        includedirs {"../include/chip8", "../src/chip8"}
+
+        flags { "ShadowedVariables"}
+
+        filter "action:vs*"
+            defines{"_CRT_SECURE_NO_WARNINGS"}
+
+        filter "options:dispatch=table"
+            defines {"CHIP8_TABLE_DISPATCH"}
+
+        filter "options:dispatch=threaded"
+            defines {"CHIP8_THREADED_DISPATCH"}
+
+        filter "system:linux"
+            links {"pthread"}
+        filter{}
+    end
+
+    project "chip8"
+        kind "StaticLib"
+        targetdir "../bin/%{cfg.buildcfg}"
+
+        chip8_library()
+
+    project "chip8_shared"
+        kind "SharedLib"
+        targetname "chip8"
+        targetdir "../bin/%{cfg.buildcfg}/shared"
+
+        defines {"CHIP8_SHARED", "CHIP8_BUILD_SHARED"}
+
+        chip8_library()
+
+    -- Headless console tools built on the static core.
+    function chip8_tool(toolDir)
+        kind "ConsoleApp"
+        location "build_files/"
+        targetdir "../bin/%{cfg.buildcfg}"
+
+        language "C"
+        cdialect "C17"
+
+        files {"../tools/" .. toolDir .. "/**.c", "../tools/" .. toolDir .. "/**.h"}
+        includedirs {"../include/chip8"}
+
+        links {"chip8"}
+
+        filter "action:vs*"
+            defines{"_CRT_SECURE_NO_WARNINGS"}
+            dependson {"chip8"}
+
+        filter "system:linux"
+            links {"pthread", "m"}
+        filter{}
+    end
+
+    project "chip8-bench"
+        chip8_tool("bench")
+        -- -f times the front end's screen filters and compositor, which are plain C with no raylib
+        -- in them.
+        files {"../src/filter.c", "../src/filter.h", "../src/compositor.c", "../src/compositor.h"}
+        includedirs {"../src"}
+
+    project "chip8-aot"
+        chip8_tool("aot")
+        -- The recompiler shares the decoder and CHIP8_OP enum with the core.
+        includedirs {"../src/chip8"}
+
+    project "chip8-batch"
+        chip8_tool("batch")
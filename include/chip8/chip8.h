@@ -12,15 +12,161 @@
 #define CHIP8_INPUTS 16
 #define CHIP8_STACK_SIZE 16
 
-// Array wrapper bc easier to copy and reinitialize. -.-
+#define CHIP8_PROGRAM_START 512
+#define CHIP8_MAX_ROM_SIZE (CHIP8_MEMORY_SIZE - CHIP8_PROGRAM_START)
+
+// Only needed on Windows when linking against the shared libchip8.
+#if defined(_WIN32) && defined(CHIP8_SHARED)
+#if defined(CHIP8_BUILD_SHARED)
+#define CHIP8_API __declspec(dllexport)
+#else
+#define CHIP8_API __declspec(dllimport)
+#endif
+#else
+#define CHIP8_API
+#endif
+
+// One 64-bit word per row (CHIP8_SCREEN_WIDTH is 64), the leftmost pixel in the most significant
+// bit. A sprite row is drawn with one rotate and one XOR, and the whole screen is 256 bytes.
 typedef struct CHIP_8GFX {
-    bool data[CHIP8_SCREEN_WIDTH * CHIP8_SCREEN_HEIGHT];
+    uint64_t rows[CHIP8_SCREEN_HEIGHT];
 } CHIP_8GFX;
 
-int CHIP8_Convert2DTo1D(int x, int y, int x_max);
-int CHIP8_LoadGameIntoMemory(const char *fileName);
-CHIP_8GFX CHIP8_GetGFX();
-void CHIP8_SimulateCycle();
-void CHIP8_SetKey(size_t key, bool active);
-void CHIP8_DecreaseTimers();
-uint8_t CHIP8_GetSoundTimer();
\ No newline at end of file
+// Every bit of a dirty-row mask (CHIP8_SCREEN_HEIGHT is 32).
+#define CHIP8_ALL_ROWS 0xFFFFFFFFu
+
+static inline bool CHIP8_GetPixel(const CHIP_8GFX* gfx, int x, int y) {
+    return (gfx->rows[y] >> (CHIP8_SCREEN_WIDTH - 1 - x)) & 1;
+}
+
+// A frame handed out by CHIP8_GetPublishedFrame. Points into the instance, nothing is copied.
+typedef struct CHIP8_FRAME_VIEW {
+    const CHIP_8GFX* gfx;
+    uint64_t version;  // CHIP8_GetFramebufferVersion when the frame was published
+    uint64_t sequence; // number of CHIP8_PublishFrame calls that produced a new frame
+} CHIP8_FRAME_VIEW;
+
+// Bumped whenever the layout of CHIP8_STATE changes; CHIP8_LoadState rejects other versions.
+#define CHIP8_STATE_VERSION 1
+
+// Complete machine state as saved by CHIP8_SaveState. Fixed-width fields in native byte order with
+// no implicit padding, so a snapshot is 4424 plain bytes that can be copied, compared or diffed
+// byte for byte. Host configuration (dispatch mode, random source callback) isn't part of it.
+typedef struct CHIP8_STATE {
+    uint32_t version; // CHIP8_STATE_VERSION
+    uint32_t rom_size;
+    uint32_t random_state;
+    uint16_t idx_register;
+    uint16_t pc_counter;
+    uint16_t stack_pointer;
+    uint16_t keys; // bit i is key i, as in CHIP8_SetKeys
+    uint16_t stack[CHIP8_STACK_SIZE];
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t v_register[CHIP8_REGISTERS];
+    uint8_t reserved[2]; // zero; keeps gfx 8-byte aligned
+    CHIP_8GFX gfx;
+    uint8_t memory[CHIP8_MEMORY_SIZE];
+} CHIP8_STATE;
+
+// Opaque handle to one emulated machine. Every instance is fully independent, so any number of
+// them can live in the same process.
+typedef struct CHIP8 CHIP8;
+
+// How the core gets from an opcode to its handler. Every mode runs ROMs identically; they only
+// differ in speed.
+typedef enum CHIP8_DISPATCH {
+    CHIP8_DISPATCH_TABLE = 0, // 64K-entry opcode -> handler table
+    CHIP8_DISPATCH_SWITCH,    // nested switch in DecodeInstruction
+    CHIP8_DISPATCH_THREADED,  // computed goto, falls back to the switch on other compilers
+    CHIP8_DISPATCH_CACHED,    // per-address pre-decoded instructions, 32 KB extra per instance
+    CHIP8_DISPATCH_JIT,       // x86-64 basic-block recompiler, 256 KB of code per instance
+    CHIP8_DISPATCH_FUSED,     // CACHED plus superinstructions for the idioms in CHIP8_FUSION
+} CHIP8_DISPATCH;
+
+// Instruction sequences CHIP8_DISPATCH_FUSED runs as one step.
+typedef enum CHIP8_FUSION {
+    CHIP8_FUSION_LOAD_PAIR = 0, // 6XNN 6YNN
+    CHIP8_FUSION_DRAW,          // ANNN DXYN
+    CHIP8_FUSION_DELAY_WAIT,    // FX07 3XNN 1NNN
+    CHIP8_FUSION_COUNTER_LOOP,  // 7XNN 3XNN 1NNN
+    CHIP8_FUSION_COUNT,
+} CHIP8_FUSION;
+
+// Returns one random byte for CXNN. Lets hosts plug in their own generator.
+typedef uint8_t (*CHIP8_RandomFunc)(void* userData);
+
+CHIP8_API CHIP8* CHIP8_Create();
+// Allocates `count` instances in a single contiguous block, released with one CHIP8_Destroy on the
+// returned pointer. Returns NULL if `count` is 0 or memory runs out. Only the returned pointer may
+// be passed to CHIP8_Destroy, never one from CHIP8_GetBatchInstance; the block goes away as a
+// whole.
+CHIP8_API CHIP8* CHIP8_CreateBatch(size_t count);
+CHIP8_API CHIP8* CHIP8_GetBatchInstance(CHIP8* batch, size_t index);
+CHIP8_API void CHIP8_Destroy(CHIP8* chip8);
+// Back to power-on state: memory cleared, fonts loaded, pc at 0x200.
+CHIP8_API void CHIP8_Reset(CHIP8* chip8);
+
+CHIP8_API int CHIP8_Convert2DTo1D(int x, int y, int x_max);
+// Copies a ROM image from memory and resets the machine. Returns -1 if it doesn't fit.
+CHIP8_API int CHIP8_LoadRom(CHIP8* chip8, const uint8_t* romData, size_t romSize);
+CHIP8_API int CHIP8_LoadGameIntoMemory(CHIP8* chip8, const char* fileName);
+CHIP8_API CHIP_8GFX CHIP8_GetGFX(CHIP8* chip8);
+// Goes up every time the framebuffer changes (draws, clears, resets) and never repeats, so equal
+// versions mean an identical frame and renderers can skip it.
+CHIP8_API uint64_t CHIP8_GetFramebufferVersion(const CHIP8* chip8);
+// Rows changed since the previous call, bit y for row y. Clears the mask.
+CHIP8_API uint32_t CHIP8_ConsumeDirtyRows(CHIP8* chip8);
+// The live framebuffer, without a copy. It changes as soon as more cycles run.
+CHIP8_API const CHIP_8GFX* CHIP8_GetGFXView(const CHIP8* chip8);
+// Call at the end of an emulated frame: copies the live framebuffer into the back buffer (only if
+// it changed since the last publish) and makes it the published frame.
+CHIP8_API void CHIP8_PublishFrame(CHIP8* chip8);
+// The last published frame. Its contents stay untouched until the second CHIP8_PublishFrame after
+// it, so a consumer can read it while the core runs the next frame. Not synchronized: the
+// consumer and CHIP8_PublishFrame must run on the same thread.
+CHIP8_API CHIP8_FRAME_VIEW CHIP8_GetPublishedFrame(const CHIP8* chip8);
+CHIP8_API void CHIP8_SimulateCycle(CHIP8* chip8);
+// Same as calling CHIP8_SimulateCycle `cycles` times, without per-instruction call overhead.
+CHIP8_API void CHIP8_RunCycles(CHIP8* chip8, uint32_t cycles);
+CHIP8_API void CHIP8_SetDispatch(CHIP8* chip8, CHIP8_DISPATCH dispatch);
+// How many times a fused sequence ran since the instance was created.
+CHIP8_API uint64_t CHIP8_GetFusionCount(const CHIP8* chip8, CHIP8_FUSION fusion);
+CHIP8_API void CHIP8_SetKey(CHIP8* chip8, size_t key, bool active);
+// Bit i of keyMask is the state of key i.
+CHIP8_API void CHIP8_SetKeys(CHIP8* chip8, uint16_t keyMask);
+CHIP8_API void CHIP8_DecreaseTimers(CHIP8* chip8);
+CHIP8_API uint8_t CHIP8_GetSoundTimer(CHIP8* chip8);
+
+// Snapshots never allocate: the caller owns the CHIP8_STATE, so taking thousands per second for
+// rewind or search is just a 4 KB copy each.
+CHIP8_API void CHIP8_SaveState(const CHIP8* chip8, CHIP8_STATE* state);
+// Restores a snapshot taken by CHIP8_SaveState, from this or any other instance. Returns -1 and
+// leaves the machine untouched if the state has a different CHIP8_STATE_VERSION. Observers see the
+// restored framebuffer as a new frame.
+CHIP8_API int CHIP8_LoadState(CHIP8* chip8, const CHIP8_STATE* state);
+
+// Without a random source CXNN uses a per-instance xorshift generator seeded with
+// CHIP8_SetRandomSeed. Pass NULL to go back to it.
+CHIP8_API void CHIP8_SetRandomSource(CHIP8* chip8, CHIP8_RandomFunc randomFunc, void* userData);
+CHIP8_API void CHIP8_SetRandomSeed(CHIP8* chip8, uint32_t seed);
+// Many copies of one ROM stepped together, for searching over inputs or seeds. State is kept
+// structure-of-arrays in chunks of 64 lanes, and lanes at the same pc run each instruction as one
+// vector operation; diverged lanes cost an extra pass per distinct pc. Each lane behaves exactly
+// like a CHIP8 instance with the ROM loaded, except that CXNN always uses the per-lane xorshift
+// generator.
+typedef struct CHIP8_LOCKSTEP CHIP8_LOCKSTEP;
+
+// Returns NULL if the ROM doesn't fit or memory runs out. Takes about 4.3 KB per lane.
+CHIP8_API CHIP8_LOCKSTEP* CHIP8_CreateLockstep(const uint8_t* romData, size_t romSize,
+                                               size_t lanes);
+CHIP8_API void CHIP8_DestroyLockstep(CHIP8_LOCKSTEP* lockstep);
+CHIP8_API size_t CHIP8_GetLockstepLaneCount(const CHIP8_LOCKSTEP* lockstep);
+// CHIP8_RunCycles on every lane.
+CHIP8_API void CHIP8_RunLockstepCycles(CHIP8_LOCKSTEP* lockstep, uint32_t cycles);
+CHIP8_API void CHIP8_DecreaseLockstepTimers(CHIP8_LOCKSTEP* lockstep);
+CHIP8_API void CHIP8_SetLockstepKeys(CHIP8_LOCKSTEP* lockstep, size_t lane, uint16_t keyMask);
+CHIP8_API void CHIP8_SetLockstepRandomSeed(CHIP8_LOCKSTEP* lockstep, size_t lane, uint32_t seed);
+CHIP8_API const CHIP_8GFX* CHIP8_GetLockstepGFX(const CHIP8_LOCKSTEP* lockstep, size_t lane);
+// Loads one lane's machine state into a regular instance, e.g. to keep playing a search result.
+CHIP8_API void CHIP8_CopyLockstepLane(const CHIP8_LOCKSTEP* lockstep, size_t lane, CHIP8* chip8);
@@ -1,28 +1,13 @@
 #include "chip8.h"
-#include <raylib.h>
+#include "chip8_internal.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-typedef struct CHIP8 {
-
-    uint8_t memory[CHIP8_MEMORY_SIZE];
-    uint8_t v_register[CHIP8_REGISTERS];
-    bool keys[CHIP8_INPUTS];
-
-    CHIP_8GFX gfx;
-    uint8_t delay_timer;
-    uint8_t sound_timer;
-
-    // uint16_t opcode;
-    uint16_t idx_register;
-    uint16_t pc_counter;
-
-    uint16_t stack[CHIP8_STACK_SIZE];
-    uint16_t stack_pointer;
-
-} CHIP8;
+// Savestates are exchanged as raw bytes, so their layout must not depend on the compiler.
+_Static_assert(sizeof(CHIP8_STATE) == 4424, "CHIP8_STATE has implicit padding");
 
 typedef struct CHIP8_INSTRUCTION {
     uint8_t byte1;
@@ -30,257 +15,127 @@ typedef struct CHIP8_INSTRUCTION {
     bool isValid;
 } CHIP8_INSTRUCTION;
 
-CHIP8 EmulatorState = {0};
-int RomSize = 0;
-
-void CHIP8_SetKey(size_t key, bool active) { EmulatorState.keys[key] = active; }
+void CHIP8_SetKey(CHIP8* chip8, size_t key, bool active) { chip8->keys[key] = active; }
 
-int CHIP8_GetKeyPressed() {
-    for (int i = 0; i < CHIP8_INPUTS; i++) {
-
-        if (EmulatorState.keys[i]) {
-            return i;
-        }
+void CHIP8_SetKeys(CHIP8* chip8, uint16_t keyMask) {
+    for (size_t i = 0; i < CHIP8_INPUTS; i++) {
+        chip8->keys[i] = (keyMask >> i) & 1;
     }
-
-    return -1;
 }
 
-void CHIP8_DecreaseTimers() {
-    if (EmulatorState.delay_timer > 0) {
-        EmulatorState.delay_timer -= 1;
+void CHIP8_DecreaseTimers(CHIP8* chip8) {
+    if (chip8->delay_timer > 0) {
+        chip8->delay_timer -= 1;
     }
 
-    if (EmulatorState.sound_timer > 0) {
-        EmulatorState.sound_timer -= 1;
+    if (chip8->sound_timer > 0) {
+        chip8->sound_timer -= 1;
     }
 }
 
-uint8_t CHIP8_GetSoundTimer() { return EmulatorState.sound_timer; }
+uint8_t CHIP8_GetSoundTimer(CHIP8* chip8) { return chip8->sound_timer; }
 
-void SkipInstruction() { EmulatorState.pc_counter += 2; }
-
-CHIP8_INSTRUCTION FetchNextInstruction() {
-    if (EmulatorState.pc_counter + 1 >= CHIP8_MEMORY_SIZE) {
+static CHIP8_INSTRUCTION FetchNextInstruction(CHIP8* chip8) {
+    if (chip8->pc_counter + 1 >= CHIP8_MEMORY_SIZE) {
         return (CHIP8_INSTRUCTION){0, 0, false};
     }
 
-    uint8_t byte1 = EmulatorState.memory[EmulatorState.pc_counter];
-    uint8_t byte2 = EmulatorState.memory[EmulatorState.pc_counter + 1];
+    uint8_t byte1 = chip8->memory[chip8->pc_counter];
+    uint8_t byte2 = chip8->memory[chip8->pc_counter + 1];
     // uint16_t nextInstruction = (byte1 << 8) | byte2;
 
-    SkipInstruction();
+    SkipInstruction(chip8);
 
     return (CHIP8_INSTRUCTION){byte1, byte2, true};
 }
 
-void JumpToNNN(uint16_t NNN) { EmulatorState.pc_counter = NNN; }
-
-void PushToStack(uint16_t NNN) {
-    EmulatorState.stack[EmulatorState.stack_pointer] = NNN;
-    EmulatorState.stack_pointer += 1;
-}
-void PopStack() {
-    EmulatorState.stack_pointer -= 1;
-    uint16_t stackAddress = EmulatorState.stack[EmulatorState.stack_pointer];
-    JumpToNNN(stackAddress);
-    EmulatorState.stack[EmulatorState.stack_pointer] = 0;
-}
-
-void SetRegister(uint8_t x, uint8_t NN) { EmulatorState.v_register[x] = NN; };
-
-uint8_t GetRegister(uint8_t x) { return EmulatorState.v_register[x]; }
-
-void Draw(uint8_t X, uint8_t Y, uint8_t N) {
-    uint8_t Vx = GetRegister(X);
-    uint8_t Vy = GetRegister(Y);
-
-    SetRegister(15, 0);
-
-    for (uint8_t h = 0; h < N; h++) {
-        uint8_t spriteByte = EmulatorState.memory[EmulatorState.idx_register + h];
-
-        for (uint8_t w = 0; w < 8; w++) {
-            // parsing from LSB to MSB :_:
-            uint8_t spritePixel = (spriteByte >> (7 - w)) & 1;
-
-            if (spritePixel == 0)
-                continue;
-
-            uint16_t x = (Vx + w) % CHIP8_SCREEN_WIDTH;
-            uint16_t y = (Vy + h) % CHIP8_SCREEN_HEIGHT;
-
-            // since gfx is one dimensional;
-            uint16_t screenIndex = CHIP8_Convert2DTo1D(x, y, CHIP8_SCREEN_WIDTH);
-
-            if (EmulatorState.gfx.data[screenIndex] == 1) {
-                SetRegister(15, 1);
-            }
-
-            EmulatorState.gfx.data[screenIndex] ^= 1;
-        }
-    }
-}
-
-void Handle0Code(uint8_t byte) {
+static void Handle0Code(CHIP8* chip8, uint8_t byte) {
     switch (byte) {
         case 0xE0:
-            // Clear screen;
-            memset(EmulatorState.gfx.data, 0, sizeof(EmulatorState.gfx.data));
+            Op00E0(chip8);
             break;
         case 0xEE:
-            PopStack();
+            Op00EE(chip8);
             break;
     }
 }
 
-void Handle8Code(uint8_t x, uint8_t y, uint8_t n_nibble) {
+static void Handle8Code(CHIP8* chip8, uint8_t x, uint8_t y, uint8_t n_nibble) {
     switch (n_nibble) {
-        case 0: {
-            uint8_t Vy = GetRegister(y);
-            SetRegister(x, Vy);
+        case 0:
+            Op8XY0(chip8, x, y);
             break;
-        }
-        case 1: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t Vy = GetRegister(y);
-            SetRegister(x, Vx | Vy);
+        case 1:
+            Op8XY1(chip8, x, y);
             break;
-        }
-        case 2: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t Vy = GetRegister(y);
-            SetRegister(x, Vx & Vy);
+        case 2:
+            Op8XY2(chip8, x, y);
             break;
-        }
-        case 3: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t Vy = GetRegister(y);
-            SetRegister(x, Vx ^ Vy);
+        case 3:
+            Op8XY3(chip8, x, y);
             break;
-        }
-        case 4: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t Vy = GetRegister(y);
-            uint16_t sum = Vx + Vy;
-            SetRegister(x, (uint8_t)sum);
-            SetRegister(15, sum > 255 ? 1 : 0);
+        case 4:
+            Op8XY4(chip8, x, y);
             break;
-        }
-        case 5: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t Vy = GetRegister(y);
-            SetRegister(x, Vx - Vy);
-            SetRegister(15, Vx >= Vy ? 1 : 0);
-
+        case 5:
+            Op8XY5(chip8, x, y);
             break;
-        }
-        case 6: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t leastSignificant = Vx & 0x01;
-            SetRegister(x, Vx >> 1);
-            SetRegister(15, leastSignificant);
+        case 6:
+            Op8XY6(chip8, x);
             break;
-        }
-        case 7: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t Vy = GetRegister(y);
-            SetRegister(x, Vy - Vx);
-            SetRegister(15, Vy >= Vx ? 1 : 0);
+        case 7:
+            Op8XY7(chip8, x, y);
             break;
-        }
-        case 0xE: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t mostSignificant = Vx & 0x80;
-            SetRegister(x, Vx << 1);
-            SetRegister(15, mostSignificant != 0);
+        case 0xE:
+            Op8XYE(chip8, x);
             break;
-        }
     }
 }
 
-void HandleFCode(uint8_t x, uint8_t nn_nibble) {
+static void HandleFCode(CHIP8* chip8, uint8_t x, uint8_t nn_nibble) {
     switch (nn_nibble) {
         case 0x07:
-            SetRegister(x, EmulatorState.delay_timer);
+            OpFX07(chip8, x);
             break;
-        case 0x0A: {
-            int keyPressed = CHIP8_GetKeyPressed();
-            if (keyPressed != -1) {
-                SetRegister(x, keyPressed);
-            } else {
-                EmulatorState.pc_counter -= 2;
-            }
+        case 0x0A:
+            OpFX0A(chip8, x);
             break;
-        }
         case 0x15:
-            EmulatorState.delay_timer = GetRegister(x);
+            OpFX15(chip8, x);
             break;
         case 0x18:
-            EmulatorState.sound_timer = GetRegister(x);
+            OpFX18(chip8, x);
             break;
         case 0x1E:
-            EmulatorState.idx_register += GetRegister(x);
+            OpFX1E(chip8, x);
             break;
         case 0x29:
-            EmulatorState.idx_register =
-                GetRegister(x) * 5; // Each font is 5 bytes so 0 x 5 = 0 < start at memory index 0
-                                    // 1 * 5 = memory index 5;
-            break;
-        case 0x33: {
-            uint8_t Vx = GetRegister(x);
-            uint8_t firstDecimal = Vx / 100;
-            uint8_t secondDecimal = (Vx / 10) % 10;
-            uint8_t thirdDecimal = Vx % 10;
-            uint16_t idx = EmulatorState.idx_register;
-            EmulatorState.memory[idx] = firstDecimal;
-            EmulatorState.memory[idx + 1] = secondDecimal;
-            EmulatorState.memory[idx + 2] = thirdDecimal;
+            OpFX29(chip8, x);
             break;
-        }
-
-        case 0x55: {
-            // x Inclusive;
-            for (size_t i = 0; i <= x; i++) {
-                EmulatorState.memory[EmulatorState.idx_register + i] = GetRegister(i);
-            }
+        case 0x33:
+            OpFX33(chip8, x);
             break;
-        }
-
-        case 0x65: {
-            // x Inclusive;
-            for (size_t i = 0; i <= x; i++) {
-                SetRegister(i, EmulatorState.memory[EmulatorState.idx_register + i]);
-            }
+        case 0x55:
+            OpFX55(chip8, x);
+            break;
+        case 0x65:
+            OpFX65(chip8, x);
             break;
-        }
     }
 }
 
-void HandleECode(uint8_t x, uint8_t nn_nibble) {
+static void HandleECode(CHIP8* chip8, uint8_t x, uint8_t nn_nibble) {
     switch (nn_nibble) {
-        case 0x9E: {
-            uint8_t key = GetRegister(x);
-
-            if (EmulatorState.keys[key]) {
-                SkipInstruction();
-            }
-
+        case 0x9E:
+            OpEX9E(chip8, x);
             break;
-        }
-        case 0xA1: {
-            uint8_t key = GetRegister(x);
-
-            if (!EmulatorState.keys[key]) {
-                SkipInstruction();
-            }
-
+        case 0xA1:
+            OpEXA1(chip8, x);
             break;
-        }
     }
 }
 
-void DecodeInstruction(CHIP8_INSTRUCTION instruction) {
+static void DecodeInstruction(CHIP8* chip8, CHIP8_INSTRUCTION instruction) {
 
     uint8_t first4Bit = instruction.byte1 >> 4;
     uint16_t second12bit = ((instruction.byte1 & 0x0F) << 8) | instruction.byte2;
@@ -292,145 +147,354 @@ void DecodeInstruction(CHIP8_INSTRUCTION instruction) {
 
     switch (first4Bit) {
         case 0:
-            Handle0Code(second12bit);
+            Handle0Code(chip8, second12bit);
             break;
         case 1:
-            // Jump to subroutine at NNN;
-            JumpToNNN(second12bit);
+            Op1NNN(chip8, second12bit);
             break;
         case 2:
-            // Push current pc to stack and calls new subroutine at NNN;
-            PushToStack(EmulatorState.pc_counter);
-            JumpToNNN(second12bit);
-            break;
-        case 3: {
-            uint8_t VxValue = GetRegister(x_nibble);
-            if (VxValue == nn_nibble) {
-                SkipInstruction();
-            }
+            Op2NNN(chip8, second12bit);
             break;
-        }
-        case 4: {
-            uint8_t VxValue = GetRegister(x_nibble);
-            if (VxValue != nn_nibble) {
-                SkipInstruction();
-            }
+        case 3:
+            Op3XNN(chip8, x_nibble, nn_nibble);
             break;
-        }
-        case 5: {
-            uint8_t VxValue = GetRegister(x_nibble);
-            uint8_t VyValue = GetRegister(y_nibble);
-
-            if (VxValue == VyValue) {
-                SkipInstruction();
-            }
-
+        case 4:
+            Op4XNN(chip8, x_nibble, nn_nibble);
+            break;
+        case 5:
+            Op5XY0(chip8, x_nibble, y_nibble);
             break;
-        }
         case 6:
-            SetRegister(x_nibble, nn_nibble);
+            Op6XNN(chip8, x_nibble, nn_nibble);
             break;
-        case 7: {
-            uint8_t VxValue = GetRegister(x_nibble);
-            SetRegister(x_nibble, VxValue + nn_nibble);
+        case 7:
+            Op7XNN(chip8, x_nibble, nn_nibble);
             break;
-        }
-
-        case 8: {
-            Handle8Code(x_nibble, y_nibble, n_nibble);
+        case 8:
+            Handle8Code(chip8, x_nibble, y_nibble, n_nibble);
             break;
-        }
-
-        case 9: {
-            uint8_t VxValue = GetRegister(x_nibble);
-            uint8_t VyValue = GetRegister(y_nibble);
-
-            if (VxValue != VyValue) {
-                SkipInstruction();
-            }
+        case 9:
+            Op9XY0(chip8, x_nibble, y_nibble);
             break;
-        }
         case 0xA:
-            EmulatorState.idx_register = second12bit;
+            OpANNN(chip8, second12bit);
             break;
         case 0xB:
-            EmulatorState.pc_counter = GetRegister(0) + second12bit;
+            OpBNNN(chip8, second12bit);
             break;
-        case 0xC: {
-            int randomValue = GetRandomValue(0, 255);
-            SetRegister(x_nibble, randomValue & nn_nibble);
+        case 0xC:
+            OpCXNN(chip8, x_nibble, nn_nibble);
             break;
-        }
         case 0xD:
-            Draw(x_nibble, y_nibble, n_nibble);
+            OpDXYN(chip8, x_nibble, y_nibble, n_nibble);
             break;
         case 0xE:
-            HandleECode(x_nibble, nn_nibble);
+            HandleECode(chip8, x_nibble, nn_nibble);
             break;
         case 0xF:
-            HandleFCode(x_nibble, nn_nibble);
+            HandleFCode(chip8, x_nibble, nn_nibble);
             break;
     }
 }
 
 int CHIP8_Convert2DTo1D(int x, int y, int x_max) { return y * x_max + x; }
 
-void LoadFontDataChip8() {
-    uint8_t fontData[80] = {
-        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-        0x20, 0x60, 0x20, 0x20, 0x70, // 1
-        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-        0xF0, 0x80, 0xF0, 0x80, 0x80  // F}
-    };
+const uint8_t CHIP8_FontData[CHIP8_FONT_SIZE] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+    0x20, 0x60, 0x20, 0x20, 0x70, // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80  // F}
+};
+
+static void LoadFontDataChip8(CHIP8* chip8) {
+    memcpy(chip8->memory, CHIP8_FontData, sizeof(CHIP8_FontData));
+}
+
+CHIP8* CHIP8_Create() { return CHIP8_CreateBatch(1); }
 
-    memcpy(EmulatorState.memory, fontData, sizeof(fontData));
+CHIP8* CHIP8_CreateBatch(size_t count) {
+    // calloc(0) may hand back a zero-size block, which has no instance 0 to record the size in.
+    if (count == 0) {
+        return NULL;
+    }
+
+    // One contiguous block so batch runners walk instances linearly instead of chasing pointers.
+    CHIP8* instances = (CHIP8*)calloc(count, sizeof(CHIP8));
+
+    if (instances == NULL) {
+        return NULL;
+    }
+
+    CHIP8_InitDispatchTables();
+
+    for (size_t i = 0; i < count; i++) {
+        instances[i].host.dispatch = CHIP8_DEFAULT_DISPATCH;
+        CHIP8_Reset(&instances[i]);
+    }
+
+    instances[0].host.batch_size = count;
+
+    return instances;
 }
 
-CHIP_8GFX CHIP8_GetGFX() { return EmulatorState.gfx; }
+CHIP8* CHIP8_GetBatchInstance(CHIP8* batch, size_t index) { return &batch[index]; }
 
-int CHIP8_LoadGameIntoMemory(const char* fileName) {
+void CHIP8_Destroy(CHIP8* chip8) {
+    // Only the first instance of a block records its size; any other one isn't the start of an
+    // allocation and can't be freed.
+    if (chip8 == NULL || chip8->host.batch_size == 0) {
+        return;
+    }
 
-    EmulatorState.gfx = (CHIP_8GFX){0};
+    for (size_t i = 0; i < chip8->host.batch_size; i++) {
+        free(chip8[i].host.decode_cache);
+#if defined(CHIP8_HAS_JIT)
+        CHIP8_JitDestroy(chip8[i].host.jit);
+#endif
+    }
 
-    printf("%s", fileName);
+    free(chip8);
+}
 
-    unsigned char* fileData = LoadFileData(fileName, &RomSize);
+void CHIP8_Reset(CHIP8* chip8) {
+    // Host configuration isn't machine state, and the generator keeps going from where it was
+    // instead of replaying the same numbers after every reset.
+    CHIP8_HOST host = chip8->host;
+    uint32_t randomState = chip8->random_state;
+    uint64_t gfxVersion = chip8->gfx_version;
 
-    if (fileData == NULL) {
-        return -1;
+    memset(chip8, 0, sizeof(CHIP8));
+
+    chip8->host = host;
+    chip8->random_state = randomState != 0 ? randomState : CHIP8_DEFAULT_RANDOM_SEED;
+
+    // Observers must see the cleared screen as a new frame.
+    chip8->gfx_dirty_rows = CHIP8_ALL_ROWS;
+    chip8->gfx_version = gfxVersion + 1;
+
+    LoadFontDataChip8(chip8);
+    CHIP8_InvalidateDecodeCache(chip8);
+
+    chip8->pc_counter = CHIP8_PROGRAM_START;
+}
+
+void CHIP8_SetRandomSource(CHIP8* chip8, CHIP8_RandomFunc randomFunc, void* userData) {
+    chip8->host.random_func = randomFunc;
+    chip8->host.random_user_data = userData;
+}
+
+void CHIP8_SetRandomSeed(CHIP8* chip8, uint32_t seed) {
+    // xorshift never leaves 0, so remap it.
+    chip8->random_state = seed != 0 ? seed : CHIP8_DEFAULT_RANDOM_SEED;
+}
+
+CHIP_8GFX CHIP8_GetGFX(CHIP8* chip8) { return chip8->gfx; }
+
+uint64_t CHIP8_GetFramebufferVersion(const CHIP8* chip8) { return chip8->gfx_version; }
+
+uint32_t CHIP8_ConsumeDirtyRows(CHIP8* chip8) {
+    uint32_t rows = chip8->gfx_dirty_rows;
+    chip8->gfx_dirty_rows = 0;
+    return rows;
+}
+
+const CHIP_8GFX* CHIP8_GetGFXView(const CHIP8* chip8) { return &chip8->gfx; }
+
+void CHIP8_PublishFrame(CHIP8* chip8) {
+    CHIP8_HOST* host = &chip8->host;
+
+    // The front buffer already holds this frame; leave both buffers alone.
+    if (host->publish_sequence != 0 &&
+        host->published_version[host->published_index] == chip8->gfx_version) {
+        return;
     }
 
-    // maybe check if romsize + 512 is bigger than memory.
+    uint32_t back = host->published_index ^ 1;
 
-    LoadFontDataChip8();
+    host->published[back] = chip8->gfx;
+    host->published_version[back] = chip8->gfx_version;
+    host->published_index = back;
+    host->publish_sequence += 1;
+}
 
-    memcpy(EmulatorState.memory + 512, fileData, RomSize);
+CHIP8_FRAME_VIEW CHIP8_GetPublishedFrame(const CHIP8* chip8) {
+    const CHIP8_HOST* host = &chip8->host;
 
-    EmulatorState.pc_counter = 512;
+    return (CHIP8_FRAME_VIEW){
+        .gfx = &host->published[host->published_index],
+        .version = host->published_version[host->published_index],
+        .sequence = host->publish_sequence,
+    };
+}
+
+int CHIP8_LoadRom(CHIP8* chip8, const uint8_t* romData, size_t romSize) {
+    if (romData == NULL || romSize > CHIP8_MAX_ROM_SIZE) {
+        return -1;
+    }
 
-    UnloadFileData(fileData);
+    CHIP8_Reset(chip8);
+
+    // Reset already dropped the decode cache, so the memcpy can't leave stale entries behind.
+    memcpy(chip8->memory + CHIP8_PROGRAM_START, romData, romSize);
+    chip8->rom_size = (int)romSize;
 
     return 0;
 }
 
-void CHIP8_SimulateCycle() {
-    CHIP8_INSTRUCTION NextInstruction = FetchNextInstruction();
+int CHIP8_LoadGameIntoMemory(CHIP8* chip8, const char* fileName) {
+    FILE* file = fopen(fileName, "rb");
 
-    if (!NextInstruction.isValid) {
-        return;
+    if (file == NULL) {
+        return -1;
     }
 
-    DecodeInstruction(NextInstruction);
-}
\ No newline at end of file
+    // Read one byte past the limit so oversized ROMs are rejected instead of truncated.
+    uint8_t romData[CHIP8_MAX_ROM_SIZE + 1];
+    size_t romSize = fread(romData, 1, sizeof(romData), file);
+
+    fclose(file);
+
+    return CHIP8_LoadRom(chip8, romData, romSize);
+}
+
+void CHIP8_SetDispatch(CHIP8* chip8, CHIP8_DISPATCH dispatch) {
+    bool usesDecodeCache = dispatch == CHIP8_DISPATCH_CACHED || dispatch == CHIP8_DISPATCH_FUSED;
+
+    if (usesDecodeCache && chip8->host.decode_cache == NULL) {
+        // If this fails RunCycles keeps using the table instead.
+        chip8->host.decode_cache =
+            (CHIP8_MICROOP*)malloc(CHIP8_MEMORY_SIZE * sizeof(CHIP8_MICROOP));
+        CHIP8_InvalidateDecodeCache(chip8);
+    } else if (usesDecodeCache && dispatch != chip8->host.dispatch) {
+        // CACHED and FUSED share the cache but not its contents.
+        CHIP8_InvalidateDecodeCache(chip8);
+    }
+
+#if defined(CHIP8_HAS_JIT)
+    if (dispatch == CHIP8_DISPATCH_JIT && chip8->host.jit == NULL) {
+        // Same deal: without executable memory RunCycles falls back to the table.
+        chip8->host.jit = CHIP8_JitCreate();
+    }
+#endif
+
+    chip8->host.dispatch = dispatch;
+}
+
+static void RunSwitchDispatch(CHIP8* chip8, uint32_t cycles) {
+    for (uint32_t i = 0; i < cycles; i++) {
+        CHIP8_INSTRUCTION NextInstruction = FetchNextInstruction(chip8);
+
+        if (!NextInstruction.isValid) {
+            return;
+        }
+
+        DecodeInstruction(chip8, NextInstruction);
+    }
+}
+
+void CHIP8_RunCycles(CHIP8* chip8, uint32_t cycles) {
+    switch (chip8->host.dispatch) {
+        case CHIP8_DISPATCH_TABLE:
+            CHIP8_RunTableDispatch(chip8, cycles);
+            break;
+        case CHIP8_DISPATCH_CACHED:
+        case CHIP8_DISPATCH_FUSED:
+            if (chip8->host.decode_cache != NULL) {
+                CHIP8_RunCachedDispatch(chip8, cycles);
+            } else {
+                CHIP8_RunTableDispatch(chip8, cycles);
+            }
+            break;
+        case CHIP8_DISPATCH_JIT:
+#if defined(CHIP8_HAS_JIT)
+            if (chip8->host.jit != NULL) {
+                CHIP8_RunJitDispatch(chip8, cycles);
+                break;
+            }
+#endif
+            CHIP8_RunTableDispatch(chip8, cycles);
+            break;
+        case CHIP8_DISPATCH_THREADED:
+#if defined(CHIP8_HAS_THREADED_DISPATCH)
+            CHIP8_RunThreadedDispatch(chip8, cycles);
+#else
+            RunSwitchDispatch(chip8, cycles);
+#endif
+            break;
+        case CHIP8_DISPATCH_SWITCH:
+        default:
+            RunSwitchDispatch(chip8, cycles);
+            break;
+    }
+}
+
+void CHIP8_SimulateCycle(CHIP8* chip8) { CHIP8_RunCycles(chip8, 1); }
+
+void CHIP8_SaveState(const CHIP8* chip8, CHIP8_STATE* state) {
+    uint16_t keys = 0;
+
+    for (size_t i = 0; i < CHIP8_INPUTS; i++) {
+        keys |= (uint16_t)chip8->keys[i] << i;
+    }
+
+    state->version = CHIP8_STATE_VERSION;
+    state->rom_size = (uint32_t)chip8->rom_size;
+    state->random_state = chip8->random_state;
+    state->idx_register = chip8->idx_register;
+    state->pc_counter = chip8->pc_counter;
+    state->stack_pointer = chip8->stack_pointer;
+    state->keys = keys;
+    memcpy(state->stack, chip8->stack, sizeof(state->stack));
+    state->delay_timer = chip8->delay_timer;
+    state->sound_timer = chip8->sound_timer;
+    memcpy(state->v_register, chip8->v_register, sizeof(state->v_register));
+    memset(state->reserved, 0, sizeof(state->reserved));
+    state->gfx = chip8->gfx;
+    memcpy(state->memory, chip8->memory, sizeof(state->memory));
+}
+
+int CHIP8_LoadState(CHIP8* chip8, const CHIP8_STATE* state) {
+    if (state->version != CHIP8_STATE_VERSION) {
+        return -1;
+    }
+
+    chip8->rom_size = (int)state->rom_size;
+    // Goes through the seed remapping in case the state was filled in by hand.
+    CHIP8_SetRandomSeed(chip8, state->random_state);
+    chip8->idx_register = state->idx_register;
+    chip8->pc_counter = state->pc_counter;
+    chip8->stack_pointer = state->stack_pointer;
+    CHIP8_SetKeys(chip8, state->keys);
+    memcpy(chip8->stack, state->stack, sizeof(chip8->stack));
+    chip8->delay_timer = state->delay_timer;
+    chip8->sound_timer = state->sound_timer;
+    memcpy(chip8->v_register, state->v_register, sizeof(chip8->v_register));
+    chip8->gfx = state->gfx;
+    memcpy(chip8->memory, state->memory, sizeof(chip8->memory));
+
+    // Memory changed behind WriteMemory's back, and the screen jumped to another frame.
+    CHIP8_InvalidateDecodeCache(chip8);
+    MarkRowsChanged(chip8, CHIP8_ALL_ROWS);
+
+    return 0;
+}
+
+uint64_t CHIP8_GetFusionCount(const CHIP8* chip8, CHIP8_FUSION fusion) {
+    if ((unsigned)fusion >= CHIP8_FUSION_COUNT) {
+        return 0;
+    }
+
+    return chip8->host.fusion_counts[fusion];
+}
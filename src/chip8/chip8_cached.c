@@ -0,0 +1,291 @@
+#include "chip8_internal.h"
+#include <stdint.h>
+#include <string.h>
+
+// Decode cache: every address gets a CHIP8_MICROOP holding the instruction kind and its operands,
+// filled the first time the address is executed. Tight ROM loops then skip fetching bytes and
+// splitting nibbles entirely. WriteMemory drops the entries a store overlaps (FX33/FX55), and a
+// ROM load resets the whole cache, so self-modifying code still runs the new bytes.
+//
+// CHIP8_DISPATCH_FUSED adds a fusion pass to the decoder: when the instructions at pc form one of
+// the CHIP8_FUSION idioms, the entry for pc runs the whole sequence in one dispatch. The other
+// instructions keep their own entries, so jumping into the middle of a sequence still works, and
+// since entries are dropped by any write to the bytes they cover, modified code decodes (and
+// fuses, or not) afresh.
+
+void CHIP8_InvalidateDecodeCache(CHIP8* chip8) {
+#if defined(CHIP8_HAS_JIT)
+    if (chip8->host.jit != NULL) {
+        CHIP8_JitFlush(chip8->host.jit);
+    }
+#endif
+
+    if (chip8->host.decode_cache == NULL) {
+        return;
+    }
+
+    // Every byte 0xFF makes every op CHIP8_MICROOP_UNDECODED.
+    memset(chip8->host.decode_cache, 0xFF, CHIP8_MEMORY_SIZE * sizeof(CHIP8_MICROOP));
+}
+
+static uint16_t ReadOpcode(CHIP8* chip8, uint16_t address) {
+    return (chip8->memory[address] << 8) | chip8->memory[address + 1];
+}
+
+static void DecodeMicroOp(CHIP8* chip8, uint16_t pc, CHIP8_MICROOP* microOp) {
+    uint16_t opcode = ReadOpcode(chip8, pc);
+
+    microOp->op = CHIP8_OpKinds[opcode];
+    microOp->x = OPCODE_X(opcode);
+    microOp->y = OPCODE_Y(opcode);
+    microOp->n = OPCODE_N(opcode);
+    microOp->nn = OPCODE_NN(opcode);
+    microOp->nnn = OPCODE_NNN(opcode);
+}
+
+// Replaces a freshly decoded micro-op with a fused one when it starts a CHIP8_FUSION idiom.
+static void FuseMicroOp(CHIP8* chip8, uint16_t pc, CHIP8_MICROOP* microOp) {
+    if (pc + CHIP8_MICROOP_MAX_SPAN > CHIP8_MEMORY_SIZE) {
+        return;
+    }
+
+    uint16_t second = ReadOpcode(chip8, pc + 2);
+    uint16_t third = ReadOpcode(chip8, pc + 4);
+    CHIP8_OP secondOp = (CHIP8_OP)CHIP8_OpKinds[second];
+    CHIP8_OP thirdOp = (CHIP8_OP)CHIP8_OpKinds[third];
+    // Third instruction of the loop idioms: 3XNN on the same register, then a jump.
+    bool loopTail = secondOp == CHIP8_OP_3XNN && OPCODE_X(second) == microOp->x &&
+                    thirdOp == CHIP8_OP_1NNN;
+
+    switch ((CHIP8_OP)microOp->op) {
+        case CHIP8_OP_6XNN:
+            if (secondOp == CHIP8_OP_6XNN) {
+                microOp->op = CHIP8_MICROOP_FUSED_LOAD_PAIR;
+                microOp->y = OPCODE_X(second);
+                microOp->n = OPCODE_NN(second);
+            }
+            break;
+        case CHIP8_OP_ANNN:
+            if (secondOp == CHIP8_OP_DXYN) {
+                microOp->op = CHIP8_MICROOP_FUSED_DRAW;
+                microOp->x = OPCODE_X(second);
+                microOp->y = OPCODE_Y(second);
+                microOp->n = OPCODE_N(second);
+            }
+            break;
+        case CHIP8_OP_FX07:
+            if (loopTail) {
+                microOp->op = CHIP8_MICROOP_FUSED_DELAY_WAIT;
+                microOp->nn = OPCODE_NN(second);
+                microOp->nnn = OPCODE_NNN(third);
+            }
+            break;
+        case CHIP8_OP_7XNN:
+            if (loopTail) {
+                microOp->op = CHIP8_MICROOP_FUSED_COUNTER_LOOP;
+                microOp->n = microOp->nn;
+                microOp->nn = OPCODE_NN(second);
+                microOp->nnn = OPCODE_NNN(third);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Instructions a fused micro-op stands for when none of them skips.
+static uint32_t FusedLength(uint8_t op) {
+    return op == CHIP8_MICROOP_FUSED_DELAY_WAIT || op == CHIP8_MICROOP_FUSED_COUNTER_LOOP ? 3 : 2;
+}
+
+void CHIP8_RunCachedDispatch(CHIP8* chip8, uint32_t cycles) {
+    CHIP8_MICROOP* cache = chip8->host.decode_cache;
+    uint64_t* fusionCounts = chip8->host.fusion_counts;
+    bool fuse = chip8->host.dispatch == CHIP8_DISPATCH_FUSED;
+
+    for (uint32_t i = 0; i < cycles; i++) {
+        uint16_t pc = chip8->pc_counter;
+
+        if (pc + 1 >= CHIP8_MEMORY_SIZE) {
+            return;
+        }
+
+        CHIP8_MICROOP* microOp = &cache[pc];
+
+        if (microOp->op == CHIP8_MICROOP_UNDECODED) {
+            DecodeMicroOp(chip8, pc, microOp);
+
+            if (fuse) {
+                FuseMicroOp(chip8, pc, microOp);
+            }
+        }
+
+        chip8->pc_counter = pc + 2;
+
+        if (microOp->op >= CHIP8_MICROOP_FUSED_FIRST && cycles - i < FusedLength(microOp->op)) {
+            // The whole sequence doesn't fit in the cycles left: run its first instruction alone.
+            CHIP8_ExecuteOpcode(chip8, ReadOpcode(chip8, pc));
+            continue;
+        }
+
+        switch (microOp->op) {
+            case CHIP8_OP_NOP:
+                break;
+            case CHIP8_OP_00E0:
+                Op00E0(chip8);
+                break;
+            case CHIP8_OP_00EE:
+                Op00EE(chip8);
+                break;
+            case CHIP8_OP_1NNN:
+                Op1NNN(chip8, microOp->nnn);
+                break;
+            case CHIP8_OP_2NNN:
+                Op2NNN(chip8, microOp->nnn);
+                break;
+            case CHIP8_OP_3XNN:
+                Op3XNN(chip8, microOp->x, microOp->nn);
+                break;
+            case CHIP8_OP_4XNN:
+                Op4XNN(chip8, microOp->x, microOp->nn);
+                break;
+            case CHIP8_OP_5XY0:
+                Op5XY0(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_6XNN:
+                Op6XNN(chip8, microOp->x, microOp->nn);
+                break;
+            case CHIP8_OP_7XNN:
+                Op7XNN(chip8, microOp->x, microOp->nn);
+                break;
+            case CHIP8_OP_8XY0:
+                Op8XY0(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XY1:
+                Op8XY1(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XY2:
+                Op8XY2(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XY3:
+                Op8XY3(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XY4:
+                Op8XY4(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XY5:
+                Op8XY5(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XY6:
+                Op8XY6(chip8, microOp->x);
+                break;
+            case CHIP8_OP_8XY7:
+                Op8XY7(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_8XYE:
+                Op8XYE(chip8, microOp->x);
+                break;
+            case CHIP8_OP_9XY0:
+                Op9XY0(chip8, microOp->x, microOp->y);
+                break;
+            case CHIP8_OP_ANNN:
+                OpANNN(chip8, microOp->nnn);
+                break;
+            case CHIP8_OP_BNNN:
+                OpBNNN(chip8, microOp->nnn);
+                break;
+            case CHIP8_OP_CXNN:
+                OpCXNN(chip8, microOp->x, microOp->nn);
+                break;
+            case CHIP8_OP_DXYN:
+                OpDXYN(chip8, microOp->x, microOp->y, microOp->n);
+                break;
+            case CHIP8_OP_EX9E:
+                OpEX9E(chip8, microOp->x);
+                break;
+            case CHIP8_OP_EXA1:
+                OpEXA1(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX07:
+                OpFX07(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX0A:
+                OpFX0A(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX15:
+                OpFX15(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX18:
+                OpFX18(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX1E:
+                OpFX1E(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX29:
+                OpFX29(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX33:
+                OpFX33(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX55:
+                OpFX55(chip8, microOp->x);
+                break;
+            case CHIP8_OP_FX65:
+                OpFX65(chip8, microOp->x);
+                break;
+            case CHIP8_MICROOP_FUSED_LOAD_PAIR:
+                Op6XNN(chip8, microOp->x, microOp->nn);
+                Op6XNN(chip8, microOp->y, microOp->n);
+                chip8->pc_counter = pc + 4;
+                fusionCounts[CHIP8_FUSION_LOAD_PAIR] += 1;
+                i += 1;
+                break;
+            case CHIP8_MICROOP_FUSED_DRAW:
+                OpANNN(chip8, microOp->nnn);
+                OpDXYN(chip8, microOp->x, microOp->y, microOp->n);
+                chip8->pc_counter = pc + 4;
+                fusionCounts[CHIP8_FUSION_DRAW] += 1;
+                i += 1;
+                break;
+            case CHIP8_MICROOP_FUSED_DELAY_WAIT:
+            case CHIP8_MICROOP_FUSED_COUNTER_LOOP: {
+                bool delayWait = microOp->op == CHIP8_MICROOP_FUSED_DELAY_WAIT;
+                CHIP8_FUSION fusion =
+                    delayWait ? CHIP8_FUSION_DELAY_WAIT : CHIP8_FUSION_COUNTER_LOOP;
+
+                if (delayWait) {
+                    OpFX07(chip8, microOp->x);
+                } else {
+                    Op7XNN(chip8, microOp->x, microOp->n);
+                }
+
+                chip8->pc_counter = pc + 4;
+                Op3XNN(chip8, microOp->x, microOp->nn);
+
+                if (chip8->pc_counter != pc + 4) {
+                    // Condition met: the jump was skipped.
+                    fusionCounts[fusion] += 1;
+                    i += 1;
+                    break;
+                }
+
+                Op1NNN(chip8, microOp->nnn);
+
+                uint64_t iterations = 1;
+
+                if (delayWait && microOp->nnn == pc) {
+                    // Polling a timer that only the host can change, from a loop that jumps to
+                    // itself: every further iteration leaves the machine exactly as it is now, so
+                    // burn the rest of the budget in one go.
+                    iterations = (cycles - i) / 3;
+                }
+
+                fusionCounts[fusion] += iterations;
+                i += (uint32_t)(iterations * 3 - 1);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
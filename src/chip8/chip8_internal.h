@@ -0,0 +1,485 @@
+#pragma once
+
+// Machine layout and opcode semantics shared by every execution backend of the core. Nothing in
+// here is part of the public API; hosts only ever see the opaque CHIP8 handle from chip8.h.
+
+#include "chip8.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHIP8_DEFAULT_RANDOM_SEED 0x2545F491u
+
+// Sixteen 5-byte glyphs at address 0, what FX29 points I at.
+#define CHIP8_FONT_SIZE 80
+extern const uint8_t CHIP8_FontData[CHIP8_FONT_SIZE];
+
+// What new instances start with: the switch, which the table doesn't reliably beat (chip8-bench
+// has it at 0.9-1.05x). `premake5 --dispatch=table` or `--dispatch=threaded` picks another mode.
+#if defined(CHIP8_THREADED_DISPATCH)
+#define CHIP8_DEFAULT_DISPATCH CHIP8_DISPATCH_THREADED
+#elif defined(CHIP8_TABLE_DISPATCH)
+#define CHIP8_DEFAULT_DISPATCH CHIP8_DISPATCH_TABLE
+#else
+#define CHIP8_DEFAULT_DISPATCH CHIP8_DISPATCH_SWITCH
+#endif
+
+// Addresses are 12 bits; I and the stack pointer are masked so a misbehaving ROM can't write past
+// the instance.
+#define CHIP8_ADDRESS_MASK (CHIP8_MEMORY_SIZE - 1)
+#define CHIP8_STACK_MASK (CHIP8_STACK_SIZE - 1)
+
+#define CHIP8_MICROOP_UNDECODED 0xFF
+// Longest sequence a single micro-op can stand for (fused triples), in bytes.
+#define CHIP8_MICROOP_MAX_SPAN 6
+
+// One pre-decoded instruction of the decode cache. Operands are extracted once, when the address
+// is first executed, and stay valid until something writes to one of the bytes it covers.
+typedef struct CHIP8_MICROOP {
+    uint8_t op; // CHIP8_OP, a CHIP8_MICROOP_FUSED_* kind, or CHIP8_MICROOP_UNDECODED
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t nn;
+    uint16_t nnn;
+} CHIP8_MICROOP;
+
+// The x86-64 recompiler only exists on x86-64 hosts; elsewhere CHIP8_DISPATCH_JIT interprets.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_HAS_JIT 1
+#endif
+
+// Translated code and block map of the recompiler, private to chip8_jit.c.
+typedef struct CHIP8_JIT CHIP8_JIT;
+
+typedef struct CHIP8_HOST {
+    CHIP8_DISPATCH dispatch;
+
+    CHIP8_RandomFunc random_func;
+    void* random_user_data;
+
+    // One entry per address, allocated the first time CHIP8_DISPATCH_CACHED is selected.
+    CHIP8_MICROOP* decode_cache;
+
+    // Allocated the first time CHIP8_DISPATCH_JIT is selected.
+    CHIP8_JIT* jit;
+
+    // Times each CHIP8_FUSION ran under CHIP8_DISPATCH_FUSED.
+    uint64_t fusion_counts[CHIP8_FUSION_COUNT];
+
+    // Double buffer behind CHIP8_PublishFrame; published_index is the front one.
+    CHIP_8GFX published[2];
+    uint64_t published_version[2];
+    uint32_t published_index;
+    uint64_t publish_sequence;
+
+    // Instances allocated together by CHIP8_CreateBatch; only set on the first one.
+    size_t batch_size;
+} CHIP8_HOST;
+
+struct CHIP8 {
+
+    uint8_t memory[CHIP8_MEMORY_SIZE];
+    uint8_t v_register[CHIP8_REGISTERS];
+    bool keys[CHIP8_INPUTS];
+
+    CHIP_8GFX gfx;
+    // Bit y set when row y changed since the last CHIP8_ConsumeDirtyRows.
+    uint32_t gfx_dirty_rows;
+    // Bumped on every change to gfx. Never goes back, not even across CHIP8_Reset.
+    uint64_t gfx_version;
+
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+
+    // uint16_t opcode;
+    uint16_t idx_register;
+    uint16_t pc_counter;
+
+    uint16_t stack[CHIP8_STACK_SIZE];
+    uint16_t stack_pointer;
+
+    int rom_size;
+
+    uint32_t random_state;
+
+    // Host configuration, kept across CHIP8_Reset.
+    CHIP8_HOST host;
+};
+
+static inline uint8_t NextRandomByte(CHIP8* chip8) {
+    if (chip8->host.random_func != NULL) {
+        return chip8->host.random_func(chip8->host.random_user_data);
+    }
+
+    // xorshift32, small enough to live in the instance and be snapshotted with it.
+    uint32_t state = chip8->random_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    chip8->random_state = state;
+
+    return (uint8_t)(state >> 24);
+}
+
+static inline int GetKeyPressed(CHIP8* chip8) {
+    for (int i = 0; i < CHIP8_INPUTS; i++) {
+
+        if (chip8->keys[i]) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+#if defined(CHIP8_HAS_JIT)
+void CHIP8_JitNotifyWrite(CHIP8_JIT* jit, uint16_t address);
+#endif
+
+static inline void SkipInstruction(CHIP8* chip8) { chip8->pc_counter += 2; }
+
+static inline void JumpToNNN(CHIP8* chip8, uint16_t NNN) { chip8->pc_counter = NNN; }
+
+static inline void PushToStack(CHIP8* chip8, uint16_t NNN) {
+    chip8->stack[chip8->stack_pointer & CHIP8_STACK_MASK] = NNN;
+    chip8->stack_pointer += 1;
+}
+
+static inline void PopStack(CHIP8* chip8) {
+    chip8->stack_pointer -= 1;
+    uint16_t stackAddress = chip8->stack[chip8->stack_pointer & CHIP8_STACK_MASK];
+    JumpToNNN(chip8, stackAddress);
+    chip8->stack[chip8->stack_pointer & CHIP8_STACK_MASK] = 0;
+}
+
+static inline void SetRegister(CHIP8* chip8, uint8_t x, uint8_t NN) {
+    chip8->v_register[x] = NN;
+}
+
+static inline uint8_t GetRegister(CHIP8* chip8, uint8_t x) { return chip8->v_register[x]; }
+
+// Drops every micro-op overlapping `address`: the one starting there and the ones starting up to
+// CHIP8_MICROOP_MAX_SPAN - 1 bytes before (a fused sequence can cover three instructions).
+static inline void InvalidateDecodedAt(CHIP8* chip8, uint16_t address) {
+    for (uint16_t back = 0; back < CHIP8_MICROOP_MAX_SPAN; back++) {
+        chip8->host.decode_cache[(address - back) & CHIP8_ADDRESS_MASK].op =
+            CHIP8_MICROOP_UNDECODED;
+    }
+}
+
+static inline void WriteMemory(CHIP8* chip8, uint16_t address, uint8_t value) {
+    address &= CHIP8_ADDRESS_MASK;
+    chip8->memory[address] = value;
+
+    if (chip8->host.decode_cache != NULL) {
+        InvalidateDecodedAt(chip8, address);
+    }
+
+#if defined(CHIP8_HAS_JIT)
+    if (chip8->host.jit != NULL) {
+        CHIP8_JitNotifyWrite(chip8->host.jit, address);
+    }
+#endif
+}
+
+static inline uint8_t ReadMemory(CHIP8* chip8, uint16_t address) {
+    return chip8->memory[address & CHIP8_ADDRESS_MASK];
+}
+
+// One function per instruction, taking already-decoded operands. Each backend only differs in how
+// it gets from an opcode to one of these.
+
+// Records that `rows` (bit y for row y) of the framebuffer changed.
+static inline void MarkRowsChanged(CHIP8* chip8, uint32_t rows) {
+    chip8->gfx_dirty_rows |= rows;
+    chip8->gfx_version += rows != 0;
+}
+
+static inline void Op00E0(CHIP8* chip8) {
+    // Clear screen; only rows that had something on them count as changed.
+    uint32_t changedRows = 0;
+
+    for (uint32_t y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        changedRows |= (uint32_t)(chip8->gfx.rows[y] != 0) << y;
+    }
+
+    memset(chip8->gfx.rows, 0, sizeof(chip8->gfx.rows));
+    MarkRowsChanged(chip8, changedRows);
+}
+
+static inline void Op00EE(CHIP8* chip8) { PopStack(chip8); }
+
+static inline void Op1NNN(CHIP8* chip8, uint16_t NNN) {
+    // Jump to subroutine at NNN;
+    JumpToNNN(chip8, NNN);
+}
+
+static inline void Op2NNN(CHIP8* chip8, uint16_t NNN) {
+    // Push current pc to stack and calls new subroutine at NNN;
+    PushToStack(chip8, chip8->pc_counter);
+    JumpToNNN(chip8, NNN);
+}
+
+static inline void Op3XNN(CHIP8* chip8, uint8_t x, uint8_t NN) {
+    if (GetRegister(chip8, x) == NN) {
+        SkipInstruction(chip8);
+    }
+}
+
+static inline void Op4XNN(CHIP8* chip8, uint8_t x, uint8_t NN) {
+    if (GetRegister(chip8, x) != NN) {
+        SkipInstruction(chip8);
+    }
+}
+
+static inline void Op5XY0(CHIP8* chip8, uint8_t x, uint8_t y) {
+    if (GetRegister(chip8, x) == GetRegister(chip8, y)) {
+        SkipInstruction(chip8);
+    }
+}
+
+static inline void Op6XNN(CHIP8* chip8, uint8_t x, uint8_t NN) { SetRegister(chip8, x, NN); }
+
+static inline void Op7XNN(CHIP8* chip8, uint8_t x, uint8_t NN) {
+    SetRegister(chip8, x, GetRegister(chip8, x) + NN);
+}
+
+static inline void Op8XY0(CHIP8* chip8, uint8_t x, uint8_t y) {
+    SetRegister(chip8, x, GetRegister(chip8, y));
+}
+
+static inline void Op8XY1(CHIP8* chip8, uint8_t x, uint8_t y) {
+    SetRegister(chip8, x, GetRegister(chip8, x) | GetRegister(chip8, y));
+}
+
+static inline void Op8XY2(CHIP8* chip8, uint8_t x, uint8_t y) {
+    SetRegister(chip8, x, GetRegister(chip8, x) & GetRegister(chip8, y));
+}
+
+static inline void Op8XY3(CHIP8* chip8, uint8_t x, uint8_t y) {
+    SetRegister(chip8, x, GetRegister(chip8, x) ^ GetRegister(chip8, y));
+}
+
+static inline void Op8XY4(CHIP8* chip8, uint8_t x, uint8_t y) {
+    uint16_t sum = GetRegister(chip8, x) + GetRegister(chip8, y);
+    SetRegister(chip8, x, (uint8_t)sum);
+    SetRegister(chip8, 15, sum > 255 ? 1 : 0);
+}
+
+static inline void Op8XY5(CHIP8* chip8, uint8_t x, uint8_t y) {
+    uint8_t Vx = GetRegister(chip8, x);
+    uint8_t Vy = GetRegister(chip8, y);
+    SetRegister(chip8, x, Vx - Vy);
+    SetRegister(chip8, 15, Vx >= Vy ? 1 : 0);
+}
+
+static inline void Op8XY6(CHIP8* chip8, uint8_t x) {
+    uint8_t Vx = GetRegister(chip8, x);
+    uint8_t leastSignificant = Vx & 0x01;
+    SetRegister(chip8, x, Vx >> 1);
+    SetRegister(chip8, 15, leastSignificant);
+}
+
+static inline void Op8XY7(CHIP8* chip8, uint8_t x, uint8_t y) {
+    uint8_t Vx = GetRegister(chip8, x);
+    uint8_t Vy = GetRegister(chip8, y);
+    SetRegister(chip8, x, Vy - Vx);
+    SetRegister(chip8, 15, Vy >= Vx ? 1 : 0);
+}
+
+static inline void Op8XYE(CHIP8* chip8, uint8_t x) {
+    uint8_t Vx = GetRegister(chip8, x);
+    uint8_t mostSignificant = Vx & 0x80;
+    SetRegister(chip8, x, Vx << 1);
+    SetRegister(chip8, 15, mostSignificant != 0);
+}
+
+static inline void Op9XY0(CHIP8* chip8, uint8_t x, uint8_t y) {
+    if (GetRegister(chip8, x) != GetRegister(chip8, y)) {
+        SkipInstruction(chip8);
+    }
+}
+
+static inline void OpANNN(CHIP8* chip8, uint16_t NNN) { chip8->idx_register = NNN; }
+
+static inline void OpBNNN(CHIP8* chip8, uint16_t NNN) {
+    chip8->pc_counter = GetRegister(chip8, 0) + NNN;
+}
+
+static inline void OpCXNN(CHIP8* chip8, uint8_t x, uint8_t NN) {
+    SetRegister(chip8, x, NextRandomByte(chip8) & NN);
+}
+
+static inline uint64_t RotateRight64(uint64_t value, unsigned shift) {
+    return (value >> shift) | (value << ((64 - shift) & 63));
+}
+
+static inline void OpDXYN(CHIP8* chip8, uint8_t X, uint8_t Y, uint8_t N) {
+    uint8_t Vx = GetRegister(chip8, X);
+    uint8_t Vy = GetRegister(chip8, Y);
+    unsigned shift = Vx % CHIP8_SCREEN_WIDTH;
+    uint64_t collision = 0;
+    uint32_t changedRows = 0;
+
+    for (uint8_t h = 0; h < N; h++) {
+        uint64_t spriteByte = ReadMemory(chip8, chip8->idx_register + h);
+        // Sprite starts at the left edge, then moves right by Vx; rotating instead of shifting
+        // wraps whatever falls off the right edge back around to the left.
+        uint64_t sprite = RotateRight64(spriteByte << (CHIP8_SCREEN_WIDTH - 8), shift);
+        uint32_t y = (Vy + h) % CHIP8_SCREEN_HEIGHT;
+        uint64_t* row = &chip8->gfx.rows[y];
+
+        collision |= *row & sprite;
+        *row ^= sprite;
+        changedRows |= (uint32_t)(sprite != 0) << y;
+    }
+
+    SetRegister(chip8, 15, collision != 0);
+    MarkRowsChanged(chip8, changedRows);
+}
+
+static inline void OpEX9E(CHIP8* chip8, uint8_t x) {
+    if (chip8->keys[GetRegister(chip8, x) & 0x0F]) {
+        SkipInstruction(chip8);
+    }
+}
+
+static inline void OpEXA1(CHIP8* chip8, uint8_t x) {
+    if (!chip8->keys[GetRegister(chip8, x) & 0x0F]) {
+        SkipInstruction(chip8);
+    }
+}
+
+static inline void OpFX07(CHIP8* chip8, uint8_t x) { SetRegister(chip8, x, chip8->delay_timer); }
+
+static inline void OpFX0A(CHIP8* chip8, uint8_t x) {
+    int keyPressed = GetKeyPressed(chip8);
+    if (keyPressed != -1) {
+        SetRegister(chip8, x, keyPressed);
+    } else {
+        chip8->pc_counter -= 2;
+    }
+}
+
+static inline void OpFX15(CHIP8* chip8, uint8_t x) { chip8->delay_timer = GetRegister(chip8, x); }
+
+static inline void OpFX18(CHIP8* chip8, uint8_t x) { chip8->sound_timer = GetRegister(chip8, x); }
+
+static inline void OpFX1E(CHIP8* chip8, uint8_t x) { chip8->idx_register += GetRegister(chip8, x); }
+
+static inline void OpFX29(CHIP8* chip8, uint8_t x) {
+    // Each font is 5 bytes so 0 x 5 = 0 < start at memory index 0
+    // 1 * 5 = memory index 5;
+    chip8->idx_register = GetRegister(chip8, x) * 5;
+}
+
+static inline void OpFX33(CHIP8* chip8, uint8_t x) {
+    uint8_t Vx = GetRegister(chip8, x);
+    uint16_t idx = chip8->idx_register;
+    WriteMemory(chip8, idx, Vx / 100);
+    WriteMemory(chip8, idx + 1, (Vx / 10) % 10);
+    WriteMemory(chip8, idx + 2, Vx % 10);
+}
+
+static inline void OpFX55(CHIP8* chip8, uint8_t x) {
+    // x Inclusive;
+    for (uint8_t i = 0; i <= x; i++) {
+        WriteMemory(chip8, chip8->idx_register + i, GetRegister(chip8, i));
+    }
+}
+
+static inline void OpFX65(CHIP8* chip8, uint8_t x) {
+    // x Inclusive;
+    for (uint8_t i = 0; i <= x; i++) {
+        SetRegister(chip8, i, ReadMemory(chip8, chip8->idx_register + i));
+    }
+}
+
+// Every instruction the core implements. Backends that need to classify an opcode (threaded
+// code, decode caches, recompilers) go through CHIP8_DecodeOp or the CHIP8_OpKinds table so
+// they all agree with DecodeInstruction.
+typedef enum CHIP8_OP {
+    CHIP8_OP_NOP = 0,
+    CHIP8_OP_00E0,
+    CHIP8_OP_00EE,
+    CHIP8_OP_1NNN,
+    CHIP8_OP_2NNN,
+    CHIP8_OP_3XNN,
+    CHIP8_OP_4XNN,
+    CHIP8_OP_5XY0,
+    CHIP8_OP_6XNN,
+    CHIP8_OP_7XNN,
+    CHIP8_OP_8XY0,
+    CHIP8_OP_8XY1,
+    CHIP8_OP_8XY2,
+    CHIP8_OP_8XY3,
+    CHIP8_OP_8XY4,
+    CHIP8_OP_8XY5,
+    CHIP8_OP_8XY6,
+    CHIP8_OP_8XY7,
+    CHIP8_OP_8XYE,
+    CHIP8_OP_9XY0,
+    CHIP8_OP_ANNN,
+    CHIP8_OP_BNNN,
+    CHIP8_OP_CXNN,
+    CHIP8_OP_DXYN,
+    CHIP8_OP_EX9E,
+    CHIP8_OP_EXA1,
+    CHIP8_OP_FX07,
+    CHIP8_OP_FX0A,
+    CHIP8_OP_FX15,
+    CHIP8_OP_FX18,
+    CHIP8_OP_FX1E,
+    CHIP8_OP_FX29,
+    CHIP8_OP_FX33,
+    CHIP8_OP_FX55,
+    CHIP8_OP_FX65,
+    CHIP8_OP_COUNT
+} CHIP8_OP;
+
+// Decode-cache kinds for fused sequences, one per CHIP8_FUSION, stored at the address of the
+// sequence's first instruction. Operand use:
+//   LOAD_PAIR     6XNN 6YNN: x, nn, then y and the second NN in n
+//   DRAW          ANNN DXYN: nnn, then x, y, n of the draw
+//   DELAY_WAIT    FX07 3XNN 1NNN: x, nn, nnn
+//   COUNTER_LOOP  7XNN 3XNN 1NNN: x, the increment in n, the compared value in nn, nnn
+#define CHIP8_MICROOP_FUSED_FIRST CHIP8_OP_COUNT
+#define CHIP8_MICROOP_FUSED_LOAD_PAIR (CHIP8_MICROOP_FUSED_FIRST + CHIP8_FUSION_LOAD_PAIR)
+#define CHIP8_MICROOP_FUSED_DRAW (CHIP8_MICROOP_FUSED_FIRST + CHIP8_FUSION_DRAW)
+#define CHIP8_MICROOP_FUSED_DELAY_WAIT (CHIP8_MICROOP_FUSED_FIRST + CHIP8_FUSION_DELAY_WAIT)
+#define CHIP8_MICROOP_FUSED_COUNTER_LOOP (CHIP8_MICROOP_FUSED_FIRST + CHIP8_FUSION_COUNTER_LOOP)
+
+#define OPCODE_X(opcode) (((opcode) >> 8) & 0x0F)
+#define OPCODE_Y(opcode) (((opcode) >> 4) & 0x0F)
+#define OPCODE_N(opcode) ((opcode) & 0x0F)
+#define OPCODE_NN(opcode) ((opcode) & 0xFF)
+#define OPCODE_NNN(opcode) ((opcode) & 0x0FFF)
+
+CHIP8_OP CHIP8_DecodeOp(uint16_t opcode);
+// CHIP8_DecodeOp for every opcode, filled by CHIP8_InitDispatchTables.
+extern uint8_t CHIP8_OpKinds[0x10000];
+
+// Backends living in their own translation units.
+void CHIP8_InitDispatchTables();
+void CHIP8_RunTableDispatch(CHIP8* chip8, uint32_t cycles);
+
+// Runs one already fetched instruction (pc must already point past it) through the table.
+void CHIP8_ExecuteOpcode(CHIP8* chip8, uint16_t opcode);
+
+// Drops everything derived from memory contents: the decode cache and translated code. Needed
+// whenever memory changes behind WriteMemory's back (reset, ROM load, state restore).
+void CHIP8_InvalidateDecodeCache(CHIP8* chip8);
+void CHIP8_RunCachedDispatch(CHIP8* chip8, uint32_t cycles);
+
+#if defined(CHIP8_HAS_JIT)
+CHIP8_JIT* CHIP8_JitCreate();
+void CHIP8_JitDestroy(CHIP8_JIT* jit);
+void CHIP8_JitFlush(CHIP8_JIT* jit);
+void CHIP8_RunJitDispatch(CHIP8* chip8, uint32_t cycles);
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_HAS_THREADED_DISPATCH 1
+void CHIP8_RunThreadedDispatch(CHIP8* chip8, uint32_t cycles);
+#endif
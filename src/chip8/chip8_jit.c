@@ -0,0 +1,819 @@
+// MAP_ANONYMOUS is not part of strict C17 + POSIX.
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include "chip8_internal.h"
+
+#if defined(CHIP8_HAS_JIT)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// x86-64 basic-block recompiler.
+//
+// A block starts at whatever pc the dispatcher lands on and runs until a control-flow instruction
+// (1NNN, 2NNN, 00EE, BNNN, the skips, FX0A) or a memory write (FX33, FX55). Register moves,
+// arithmetic, timers and I are emitted as native code. Everything else (draws, random numbers,
+// FX65, ...) calls back into the interpreter through CHIP8_ExecuteOpcode, so there is exactly one
+// implementation of the tricky instructions.
+//
+// Register use inside translated code:
+//   rbx      CHIP8* of the running instance
+//   rbp      cycles left; a block only runs if all of its instructions fit
+//   r12-r15  up to four of the block's busiest V registers, written back before every helper
+//            call and exit
+//   rax/rcx/rdx scratch
+//
+// Blocks end by storing the next pc and jumping straight into the next translated block when
+// there is one (chaining), otherwise they return to CHIP8_RunJitDispatch. A store into memory that
+// has been translated sets flush_pending; since every store ends its block, the dispatcher
+// throws all translated code away before anything stale can run again.
+
+#define JIT_CODE_SIZE (256 * 1024)
+#define JIT_MAX_BLOCK_INSTRUCTIONS 64
+// Worst case for one translated instruction plus a block exit.
+#define JIT_INSTRUCTION_RESERVE 192
+#define JIT_CACHED_REGISTERS 4
+
+typedef int64_t (*JitEnterFunc)(CHIP8* chip8, int64_t cycles, const uint8_t* block);
+
+struct CHIP8_JIT {
+    uint8_t* code;
+    size_t used;
+    size_t blocksStart;
+
+    JitEnterFunc enter;
+    const uint8_t* epilogue;
+
+    const uint8_t* blocks[CHIP8_MEMORY_SIZE];
+    bool translated[CHIP8_MEMORY_SIZE];
+    bool flushPending;
+};
+
+// Per-block emission state.
+typedef struct JitBlock {
+    CHIP8_JIT* jit;
+    // Host register holding each V register, or -1 when it stays in memory.
+    int8_t hostRegister[CHIP8_REGISTERS];
+} JitBlock;
+
+enum { RAX = 0, RCX = 1, RDX = 2 };
+
+#define V_OFFSET(x) ((int32_t)(offsetof(CHIP8, v_register) + (x)))
+#define PC_OFFSET ((int32_t)offsetof(CHIP8, pc_counter))
+#define I_OFFSET ((int32_t)offsetof(CHIP8, idx_register))
+#define DELAY_OFFSET ((int32_t)offsetof(CHIP8, delay_timer))
+#define SOUND_OFFSET ((int32_t)offsetof(CHIP8, sound_timer))
+
+static void Emit8(CHIP8_JIT* jit, uint8_t byte) { jit->code[jit->used++] = byte; }
+
+static void Emit16(CHIP8_JIT* jit, uint16_t value) {
+    memcpy(jit->code + jit->used, &value, sizeof(value));
+    jit->used += sizeof(value);
+}
+
+static void Emit32(CHIP8_JIT* jit, uint32_t value) {
+    memcpy(jit->code + jit->used, &value, sizeof(value));
+    jit->used += sizeof(value);
+}
+
+static void Emit64(CHIP8_JIT* jit, uint64_t value) {
+    memcpy(jit->code + jit->used, &value, sizeof(value));
+    jit->used += sizeof(value);
+}
+
+// ModRM for [rbx + disp32] with `reg` in the reg field.
+static void EmitRbxOperand(CHIP8_JIT* jit, int reg, int32_t displacement) {
+    Emit8(jit, 0x80 | ((reg & 7) << 3) | 3);
+    Emit32(jit, (uint32_t)displacement);
+}
+
+// Jcc/JMP rel32 to an absolute address inside the code buffer.
+static void EmitJumpTo(CHIP8_JIT* jit, uint8_t conditionOpcode, const uint8_t* target) {
+    if (conditionOpcode == 0) {
+        Emit8(jit, 0xE9);
+    } else {
+        Emit8(jit, 0x0F);
+        Emit8(jit, conditionOpcode);
+    }
+
+    const uint8_t* next = jit->code + jit->used + 4;
+    Emit32(jit, (uint32_t)(int32_t)(target - next));
+}
+
+#define JCC_JE 0x84
+#define JCC_JNE 0x85
+#define JCC_JA 0x87
+#define JCC_JL 0x8C
+#define JMP_ALWAYS 0
+
+// reg32 = zero-extended Vx
+static void EmitLoadV(JitBlock* block, int reg, uint8_t x) {
+    CHIP8_JIT* jit = block->jit;
+    int host = block->hostRegister[x];
+
+    if (host >= 0) {
+        // mov reg32, r1Xd
+        Emit8(jit, 0x44);
+        Emit8(jit, 0x89);
+        Emit8(jit, 0xC0 | ((host & 7) << 3) | reg);
+    } else {
+        // movzx reg32, byte [rbx + V]
+        Emit8(jit, 0x0F);
+        Emit8(jit, 0xB6);
+        EmitRbxOperand(jit, reg, V_OFFSET(x));
+    }
+}
+
+// Vx = low byte of reg
+static void EmitStoreV(JitBlock* block, uint8_t x, int reg) {
+    CHIP8_JIT* jit = block->jit;
+    int host = block->hostRegister[x];
+
+    if (host >= 0) {
+        // movzx r1Xd, reg8
+        Emit8(jit, 0x44);
+        Emit8(jit, 0x0F);
+        Emit8(jit, 0xB6);
+        Emit8(jit, 0xC0 | ((host & 7) << 3) | reg);
+    } else {
+        // mov byte [rbx + V], reg8
+        Emit8(jit, 0x88);
+        EmitRbxOperand(jit, reg, V_OFFSET(x));
+    }
+}
+
+static void EmitLoadCachedRegisters(JitBlock* block) {
+    for (uint8_t x = 0; x < CHIP8_REGISTERS; x++) {
+        if (block->hostRegister[x] >= 0) {
+            // movzx r1Xd, byte [rbx + V]
+            Emit8(block->jit, 0x44);
+            Emit8(block->jit, 0x0F);
+            Emit8(block->jit, 0xB6);
+            EmitRbxOperand(block->jit, block->hostRegister[x], V_OFFSET(x));
+        }
+    }
+}
+
+static void EmitStoreCachedRegisters(JitBlock* block) {
+    for (uint8_t x = 0; x < CHIP8_REGISTERS; x++) {
+        if (block->hostRegister[x] >= 0) {
+            // mov byte [rbx + V], r1Xb
+            Emit8(block->jit, 0x44);
+            Emit8(block->jit, 0x88);
+            EmitRbxOperand(block->jit, block->hostRegister[x], V_OFFSET(x));
+        }
+    }
+}
+
+static void EmitStorePc(CHIP8_JIT* jit, uint16_t pc) {
+    // mov word [rbx + pc], imm16
+    Emit8(jit, 0x66);
+    Emit8(jit, 0xC7);
+    EmitRbxOperand(jit, 0, PC_OFFSET);
+    Emit16(jit, pc);
+}
+
+// Runs `opcode` through the interpreter with pc already past it, like every handler expects.
+static void EmitInterpreterCall(JitBlock* block, uint16_t address, uint16_t opcode) {
+    CHIP8_JIT* jit = block->jit;
+
+    EmitStoreCachedRegisters(block);
+    EmitStorePc(jit, address + 2);
+
+#if defined(_WIN32)
+    // mov rcx, rbx ; mov edx, opcode
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xD9);
+    Emit8(jit, 0xBA);
+#else
+    // mov rdi, rbx ; mov esi, opcode
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xDF);
+    Emit8(jit, 0xBE);
+#endif
+    Emit32(jit, opcode);
+
+    // mov rax, CHIP8_ExecuteOpcode ; call rax
+    Emit8(jit, 0x48);
+    Emit8(jit, 0xB8);
+    Emit64(jit, (uint64_t)(uintptr_t)&CHIP8_ExecuteOpcode);
+    Emit8(jit, 0xFF);
+    Emit8(jit, 0xD0);
+}
+
+// Continues at the pc stored in the instance: chains into its block if there is one, otherwise
+// returns to the dispatcher.
+static void EmitDynamicExit(CHIP8_JIT* jit) {
+    // movzx eax, word [rbx + pc]
+    Emit8(jit, 0x0F);
+    Emit8(jit, 0xB7);
+    EmitRbxOperand(jit, RAX, PC_OFFSET);
+    // cmp eax, CHIP8_MEMORY_SIZE - 2 ; ja epilogue
+    Emit8(jit, 0x3D);
+    Emit32(jit, CHIP8_MEMORY_SIZE - 2);
+    EmitJumpTo(jit, JCC_JA, jit->epilogue);
+    // mov rcx, blocks ; mov rax, [rcx + rax * 8]
+    Emit8(jit, 0x48);
+    Emit8(jit, 0xB9);
+    Emit64(jit, (uint64_t)(uintptr_t)jit->blocks);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x8B);
+    Emit8(jit, 0x04);
+    Emit8(jit, 0xC1);
+    // test rax, rax ; jz epilogue ; jmp rax
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x85);
+    Emit8(jit, 0xC0);
+    EmitJumpTo(jit, JCC_JE, jit->epilogue);
+    Emit8(jit, 0xFF);
+    Emit8(jit, 0xE0);
+}
+
+static void EmitStaticExit(JitBlock* block, uint16_t target) {
+    CHIP8_JIT* jit = block->jit;
+
+    EmitStoreCachedRegisters(block);
+    EmitStorePc(jit, target);
+
+    if (target + 1 >= CHIP8_MEMORY_SIZE) {
+        EmitJumpTo(jit, JMP_ALWAYS, jit->epilogue);
+        return;
+    }
+
+    // mov rax, &blocks[target] ; mov rax, [rax] ; test rax, rax ; jz epilogue ; jmp rax
+    Emit8(jit, 0x48);
+    Emit8(jit, 0xB8);
+    Emit64(jit, (uint64_t)(uintptr_t)&jit->blocks[target]);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x8B);
+    Emit8(jit, 0x00);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x85);
+    Emit8(jit, 0xC0);
+    EmitJumpTo(jit, JCC_JE, jit->epilogue);
+    Emit8(jit, 0xFF);
+    Emit8(jit, 0xE0);
+}
+
+// Skips: `jumpIfSkip` is the condition under which the next instruction is skipped, evaluated on
+// flags the caller just set.
+static void EmitSkipExit(JitBlock* block, uint16_t address, uint8_t jumpIfSkip) {
+    CHIP8_JIT* jit = block->jit;
+
+    Emit8(jit, 0x0F);
+    Emit8(jit, jumpIfSkip);
+    size_t patch = jit->used;
+    Emit32(jit, 0);
+
+    EmitStaticExit(block, address + 2);
+
+    int32_t distance = (int32_t)(jit->used - (patch + 4));
+    memcpy(jit->code + patch, &distance, sizeof(distance));
+
+    EmitStaticExit(block, address + 4);
+}
+
+static void EmitAluVxVy(JitBlock* block, uint8_t x, uint8_t y, uint8_t aluOpcode) {
+    EmitLoadV(block, RAX, x);
+    EmitLoadV(block, RCX, y);
+    // op eax, ecx
+    Emit8(block->jit, aluOpcode);
+    Emit8(block->jit, 0xC8);
+    EmitStoreV(block, x, RAX);
+}
+
+static bool IsBlockTerminator(CHIP8_OP op) {
+    switch (op) {
+        case CHIP8_OP_00EE:
+        case CHIP8_OP_1NNN:
+        case CHIP8_OP_2NNN:
+        case CHIP8_OP_3XNN:
+        case CHIP8_OP_4XNN:
+        case CHIP8_OP_5XY0:
+        case CHIP8_OP_9XY0:
+        case CHIP8_OP_BNNN:
+        case CHIP8_OP_EX9E:
+        case CHIP8_OP_EXA1:
+        case CHIP8_OP_FX0A:
+        case CHIP8_OP_FX33:
+        case CHIP8_OP_FX55:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Ops emitted as native code, the only ones whose V operands can live in host registers.
+static bool IsNativeOp(CHIP8_OP op) {
+    switch (op) {
+        case CHIP8_OP_3XNN:
+        case CHIP8_OP_4XNN:
+        case CHIP8_OP_5XY0:
+        case CHIP8_OP_6XNN:
+        case CHIP8_OP_7XNN:
+        case CHIP8_OP_8XY0:
+        case CHIP8_OP_8XY1:
+        case CHIP8_OP_8XY2:
+        case CHIP8_OP_8XY3:
+        case CHIP8_OP_8XY4:
+        case CHIP8_OP_8XY5:
+        case CHIP8_OP_8XY6:
+        case CHIP8_OP_8XY7:
+        case CHIP8_OP_8XYE:
+        case CHIP8_OP_9XY0:
+        case CHIP8_OP_FX07:
+        case CHIP8_OP_FX15:
+        case CHIP8_OP_FX18:
+        case CHIP8_OP_FX1E:
+        case CHIP8_OP_FX29:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint16_t ReadOpcode(CHIP8* chip8, uint16_t address) {
+    return (chip8->memory[address] << 8) | chip8->memory[address + 1];
+}
+
+// Gives the block's most used V registers (in native ops) a host register each.
+static void AllocateRegisters(CHIP8* chip8, JitBlock* block, uint16_t start, int count) {
+    int uses[CHIP8_REGISTERS] = {0};
+
+    for (int i = 0; i < count; i++) {
+        uint16_t opcode = ReadOpcode(chip8, start + i * 2);
+        CHIP8_OP op = (CHIP8_OP)CHIP8_OpKinds[opcode];
+
+        if (!IsNativeOp(op)) {
+            continue;
+        }
+
+        uses[OPCODE_X(opcode)] += 1;
+        bool readsY = op == CHIP8_OP_5XY0 || op == CHIP8_OP_9XY0 ||
+                      (op >= CHIP8_OP_8XY0 && op <= CHIP8_OP_8XY7 && op != CHIP8_OP_8XY6);
+        if (readsY) {
+            uses[OPCODE_Y(opcode)] += 1;
+        }
+        // The flag-setting 8XYn ops also write VF.
+        if (op >= CHIP8_OP_8XY4 && op <= CHIP8_OP_8XYE) {
+            uses[0xF] += 1;
+        }
+    }
+
+    memset(block->hostRegister, -1, sizeof(block->hostRegister));
+
+    for (int reg = 0; reg < JIT_CACHED_REGISTERS; reg++) {
+        int best = -1;
+
+        for (int x = 0; x < CHIP8_REGISTERS; x++) {
+            if (block->hostRegister[x] < 0 && uses[x] >= 2 && (best < 0 || uses[x] > uses[best])) {
+                best = x;
+            }
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        block->hostRegister[best] = (int8_t)(12 + reg);
+    }
+}
+
+static void EmitInstruction(JitBlock* block, uint16_t address, uint16_t opcode) {
+    CHIP8_JIT* jit = block->jit;
+    CHIP8_OP op = (CHIP8_OP)CHIP8_OpKinds[opcode];
+    uint8_t x = OPCODE_X(opcode);
+    uint8_t y = OPCODE_Y(opcode);
+    uint8_t nn = OPCODE_NN(opcode);
+    uint16_t nnn = OPCODE_NNN(opcode);
+
+    switch (op) {
+        case CHIP8_OP_NOP:
+            break;
+
+        case CHIP8_OP_1NNN:
+            EmitStaticExit(block, nnn);
+            break;
+
+        case CHIP8_OP_3XNN:
+        case CHIP8_OP_4XNN:
+            EmitLoadV(block, RAX, x);
+            // cmp eax, imm32
+            Emit8(jit, 0x3D);
+            Emit32(jit, nn);
+            EmitSkipExit(block, address, op == CHIP8_OP_3XNN ? JCC_JE : JCC_JNE);
+            break;
+
+        case CHIP8_OP_5XY0:
+        case CHIP8_OP_9XY0:
+            EmitLoadV(block, RAX, x);
+            EmitLoadV(block, RCX, y);
+            // cmp eax, ecx
+            Emit8(jit, 0x39);
+            Emit8(jit, 0xC8);
+            EmitSkipExit(block, address, op == CHIP8_OP_5XY0 ? JCC_JE : JCC_JNE);
+            break;
+
+        case CHIP8_OP_6XNN:
+            // mov eax, imm32
+            Emit8(jit, 0xB8);
+            Emit32(jit, nn);
+            EmitStoreV(block, x, RAX);
+            break;
+
+        case CHIP8_OP_7XNN:
+            EmitLoadV(block, RAX, x);
+            // add eax, imm32
+            Emit8(jit, 0x05);
+            Emit32(jit, nn);
+            EmitStoreV(block, x, RAX);
+            break;
+
+        case CHIP8_OP_8XY0:
+            EmitLoadV(block, RAX, y);
+            EmitStoreV(block, x, RAX);
+            break;
+
+        case CHIP8_OP_8XY1:
+            EmitAluVxVy(block, x, y, 0x09); // or
+            break;
+
+        case CHIP8_OP_8XY2:
+            EmitAluVxVy(block, x, y, 0x21); // and
+            break;
+
+        case CHIP8_OP_8XY3:
+            EmitAluVxVy(block, x, y, 0x31); // xor
+            break;
+
+        case CHIP8_OP_8XY4:
+            EmitAluVxVy(block, x, y, 0x01); // add
+            // shr eax, 8 -> carry out of the 8-bit sum
+            Emit8(jit, 0xC1);
+            Emit8(jit, 0xE8);
+            Emit8(jit, 0x08);
+            EmitStoreV(block, 0xF, RAX);
+            break;
+
+        case CHIP8_OP_8XY5:
+        case CHIP8_OP_8XY7:
+            EmitLoadV(block, RAX, x);
+            EmitLoadV(block, RCX, y);
+            if (op == CHIP8_OP_8XY5) {
+                // cmp eax, ecx ; setae dl ; sub eax, ecx
+                Emit8(jit, 0x39);
+                Emit8(jit, 0xC8);
+                Emit8(jit, 0x0F);
+                Emit8(jit, 0x93);
+                Emit8(jit, 0xC2);
+                Emit8(jit, 0x29);
+                Emit8(jit, 0xC8);
+                EmitStoreV(block, x, RAX);
+            } else {
+                // cmp ecx, eax ; setae dl ; sub ecx, eax
+                Emit8(jit, 0x39);
+                Emit8(jit, 0xC1);
+                Emit8(jit, 0x0F);
+                Emit8(jit, 0x93);
+                Emit8(jit, 0xC2);
+                Emit8(jit, 0x29);
+                Emit8(jit, 0xC1);
+                EmitStoreV(block, x, RCX);
+            }
+            EmitStoreV(block, 0xF, RDX);
+            break;
+
+        case CHIP8_OP_8XY6:
+            EmitLoadV(block, RAX, x);
+            // mov edx, eax ; and edx, 1 ; shr eax, 1
+            Emit8(jit, 0x89);
+            Emit8(jit, 0xC2);
+            Emit8(jit, 0x83);
+            Emit8(jit, 0xE2);
+            Emit8(jit, 0x01);
+            Emit8(jit, 0xD1);
+            Emit8(jit, 0xE8);
+            EmitStoreV(block, x, RAX);
+            EmitStoreV(block, 0xF, RDX);
+            break;
+
+        case CHIP8_OP_8XYE:
+            EmitLoadV(block, RAX, x);
+            // mov edx, eax ; shr edx, 7 ; shl eax, 1
+            Emit8(jit, 0x89);
+            Emit8(jit, 0xC2);
+            Emit8(jit, 0xC1);
+            Emit8(jit, 0xEA);
+            Emit8(jit, 0x07);
+            Emit8(jit, 0xD1);
+            Emit8(jit, 0xE0);
+            EmitStoreV(block, x, RAX);
+            EmitStoreV(block, 0xF, RDX);
+            break;
+
+        case CHIP8_OP_ANNN:
+            // mov word [rbx + I], imm16
+            Emit8(jit, 0x66);
+            Emit8(jit, 0xC7);
+            EmitRbxOperand(jit, 0, I_OFFSET);
+            Emit16(jit, nnn);
+            break;
+
+        case CHIP8_OP_FX07:
+            // movzx eax, byte [rbx + delay]
+            Emit8(jit, 0x0F);
+            Emit8(jit, 0xB6);
+            EmitRbxOperand(jit, RAX, DELAY_OFFSET);
+            EmitStoreV(block, x, RAX);
+            break;
+
+        case CHIP8_OP_FX15:
+        case CHIP8_OP_FX18:
+            EmitLoadV(block, RAX, x);
+            // mov byte [rbx + timer], al
+            Emit8(jit, 0x88);
+            EmitRbxOperand(jit, RAX, op == CHIP8_OP_FX15 ? DELAY_OFFSET : SOUND_OFFSET);
+            break;
+
+        case CHIP8_OP_FX1E:
+            EmitLoadV(block, RAX, x);
+            // add word [rbx + I], ax
+            Emit8(jit, 0x66);
+            Emit8(jit, 0x01);
+            EmitRbxOperand(jit, RAX, I_OFFSET);
+            break;
+
+        case CHIP8_OP_FX29:
+            EmitLoadV(block, RAX, x);
+            // lea eax, [rax + rax * 4] ; mov word [rbx + I], ax
+            Emit8(jit, 0x8D);
+            Emit8(jit, 0x04);
+            Emit8(jit, 0x80);
+            Emit8(jit, 0x66);
+            Emit8(jit, 0x89);
+            EmitRbxOperand(jit, RAX, I_OFFSET);
+            break;
+
+        case CHIP8_OP_00EE:
+        case CHIP8_OP_2NNN:
+        case CHIP8_OP_BNNN:
+        case CHIP8_OP_EX9E:
+        case CHIP8_OP_EXA1:
+        case CHIP8_OP_FX0A:
+            // The interpreter works out the next pc; follow it from there.
+            EmitInterpreterCall(block, address, opcode);
+            EmitDynamicExit(jit);
+            break;
+
+        case CHIP8_OP_FX33:
+        case CHIP8_OP_FX55:
+            // Stores may hit translated code, so always hand control back to the dispatcher.
+            EmitInterpreterCall(block, address, opcode);
+            EmitJumpTo(jit, JMP_ALWAYS, jit->epilogue);
+            break;
+
+        default:
+            // 00E0, CXNN, DXYN, FX65: interpreter, then pick the cached registers back up.
+            EmitInterpreterCall(block, address, opcode);
+            EmitLoadCachedRegisters(block);
+            break;
+    }
+}
+
+static const uint8_t* TranslateBlock(CHIP8* chip8, CHIP8_JIT* jit, uint16_t start) {
+    // Find the extent of the block first so registers can be allocated for all of it.
+    int count = 0;
+    bool terminated = false;
+
+    for (uint16_t address = start;
+         count < JIT_MAX_BLOCK_INSTRUCTIONS && address + 1 < CHIP8_MEMORY_SIZE; address += 2) {
+        count += 1;
+
+        if (IsBlockTerminator((CHIP8_OP)CHIP8_OpKinds[ReadOpcode(chip8, address)])) {
+            terminated = true;
+            break;
+        }
+    }
+
+    size_t worstCase = (size_t)(count + 2) * JIT_INSTRUCTION_RESERVE;
+    if (jit->used + worstCase > JIT_CODE_SIZE) {
+        return NULL;
+    }
+
+    JitBlock block = {.jit = jit};
+    AllocateRegisters(chip8, &block, start, count);
+
+    const uint8_t* entry = jit->code + jit->used;
+
+    // cmp rbp, count ; jl epilogue ; sub rbp, count
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x81);
+    Emit8(jit, 0xFD);
+    Emit32(jit, (uint32_t)count);
+    EmitJumpTo(jit, JCC_JL, jit->epilogue);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x81);
+    Emit8(jit, 0xED);
+    Emit32(jit, (uint32_t)count);
+
+    EmitLoadCachedRegisters(&block);
+
+    for (int i = 0; i < count; i++) {
+        uint16_t address = start + i * 2;
+
+        jit->translated[address] = true;
+        jit->translated[address + 1] = true;
+
+        EmitInstruction(&block, address, ReadOpcode(chip8, address));
+    }
+
+    if (!terminated) {
+        EmitStaticExit(&block, start + count * 2);
+    }
+
+    jit->blocks[start] = entry;
+
+    return entry;
+}
+
+// Entry trampoline: saves the callee-saved registers translated code uses, then jumps into the
+// block. The epilogue right after it returns the cycles left.
+static void EmitTrampoline(CHIP8_JIT* jit) {
+    // push rbx ; push rbp ; push r12 ; push r13 ; push r14 ; push r15
+    Emit8(jit, 0x53);
+    Emit8(jit, 0x55);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x54);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x55);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x56);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x57);
+
+#if defined(_WIN32)
+    // Keep rsp 16-byte aligned and leave 32 bytes of shadow space for helper calls.
+    const uint8_t frameSize = 40;
+    // sub rsp, 40 ; mov rbx, rcx ; mov rbp, rdx ; jmp r8
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x83);
+    Emit8(jit, 0xEC);
+    Emit8(jit, frameSize);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xCB);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xD5);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0xFF);
+    Emit8(jit, 0xE0);
+#else
+    const uint8_t frameSize = 8;
+    // sub rsp, 8 ; mov rbx, rdi ; mov rbp, rsi ; jmp rdx
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x83);
+    Emit8(jit, 0xEC);
+    Emit8(jit, frameSize);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xFB);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xF5);
+    Emit8(jit, 0xFF);
+    Emit8(jit, 0xE2);
+#endif
+
+    jit->epilogue = jit->code + jit->used;
+
+    // mov rax, rbp ; add rsp, frame ; pop r15 ; pop r14 ; pop r13 ; pop r12 ; pop rbp ; pop rbx ;
+    // ret
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x89);
+    Emit8(jit, 0xE8);
+    Emit8(jit, 0x48);
+    Emit8(jit, 0x83);
+    Emit8(jit, 0xC4);
+    Emit8(jit, frameSize);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x5F);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x5E);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x5D);
+    Emit8(jit, 0x41);
+    Emit8(jit, 0x5C);
+    Emit8(jit, 0x5D);
+    Emit8(jit, 0x5B);
+    Emit8(jit, 0xC3);
+}
+
+CHIP8_JIT* CHIP8_JitCreate() {
+    CHIP8_JIT* jit = (CHIP8_JIT*)calloc(1, sizeof(CHIP8_JIT));
+
+    if (jit == NULL) {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    jit->code = (uint8_t*)VirtualAlloc(NULL, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE,
+                                       PAGE_EXECUTE_READWRITE);
+#else
+    void* code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    jit->code = code == MAP_FAILED ? NULL : (uint8_t*)code;
+#endif
+
+    if (jit->code == NULL) {
+        free(jit);
+        return NULL;
+    }
+
+    EmitTrampoline(jit);
+    jit->enter = (JitEnterFunc)(void*)jit->code;
+    jit->blocksStart = jit->used;
+
+    return jit;
+}
+
+void CHIP8_JitDestroy(CHIP8_JIT* jit) {
+    if (jit == NULL) {
+        return;
+    }
+
+#if defined(_WIN32)
+    VirtualFree(jit->code, 0, MEM_RELEASE);
+#else
+    munmap(jit->code, JIT_CODE_SIZE);
+#endif
+
+    free(jit);
+}
+
+void CHIP8_JitFlush(CHIP8_JIT* jit) {
+    jit->used = jit->blocksStart;
+    jit->flushPending = false;
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->translated, 0, sizeof(jit->translated));
+}
+
+void CHIP8_JitNotifyWrite(CHIP8_JIT* jit, uint16_t address) {
+    if (jit->translated[address]) {
+        jit->flushPending = true;
+    }
+}
+
+void CHIP8_RunJitDispatch(CHIP8* chip8, uint32_t cycles) {
+    CHIP8_JIT* jit = chip8->host.jit;
+    int64_t remaining = cycles;
+
+    while (remaining > 0) {
+        if (jit->flushPending) {
+            CHIP8_JitFlush(jit);
+        }
+
+        uint16_t pc = chip8->pc_counter;
+
+        if (pc + 1 >= CHIP8_MEMORY_SIZE) {
+            return;
+        }
+
+        const uint8_t* block = jit->blocks[pc];
+
+        if (block == NULL) {
+            block = TranslateBlock(chip8, jit, pc);
+        }
+
+        if (block == NULL) {
+            // Out of code space: start over with an empty cache.
+            CHIP8_JitFlush(jit);
+            block = TranslateBlock(chip8, jit, pc);
+        }
+
+        int64_t left = block != NULL ? jit->enter(chip8, remaining, block) : remaining;
+
+        if (left == remaining) {
+            // Fewer cycles left than the block is long; finish instruction by instruction.
+            CHIP8_RunTableDispatch(chip8, 1);
+            left -= 1;
+        }
+
+        remaining = left;
+    }
+}
+
+#endif
@@ -0,0 +1,580 @@
+#include "chip8_internal.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lockstep core: many copies of one ROM, stored structure-of-arrays in chunks of
+// CHIP8_LOCKSTEP_WIDTH lanes. Every step, the lanes of a chunk are regrouped by pc and opcode,
+// and each group runs its instruction once for all of its lanes: loops over a chunk with a
+// per-lane select mask, fixed-length so the compiler turns them into SSE2 code (AVX2 when the
+// build targets it). Lanes that took a different branch simply form another group, and are back
+// in the same group as soon as their pcs meet again.
+//
+// Instructions that index memory or the framebuffer per lane (00E0, 00EE, 2NNN, DXYN, FX0A,
+// FX33, FX55, FX65) loop over the lanes of the group one at a time instead.
+//
+// Each lane has its own copy of memory, and a group only forms from lanes holding the same
+// opcode bytes at the same pc, so self-modifying code in one lane never leaks into the others.
+
+// Wide enough to amortize regrouping and dispatch over many lanes, narrow enough that lanes of a
+// chunk rarely spread over more than a few pcs.
+#define CHIP8_LOCKSTEP_WIDTH 64
+
+#define FOR_LANES(lane) for (int lane = 0; lane < CHIP8_LOCKSTEP_WIDTH; lane++)
+
+typedef struct LockstepChunk {
+    // memory[address][lane]: the bytes all lanes hold at one address sit side by side, so
+    // fetching an opcode for the whole chunk is two contiguous loads.
+    uint8_t memory[CHIP8_MEMORY_SIZE][CHIP8_LOCKSTEP_WIDTH];
+    uint8_t v_register[CHIP8_REGISTERS][CHIP8_LOCKSTEP_WIDTH];
+    uint16_t idx_register[CHIP8_LOCKSTEP_WIDTH];
+    uint16_t pc_counter[CHIP8_LOCKSTEP_WIDTH];
+    uint16_t stack[CHIP8_STACK_SIZE][CHIP8_LOCKSTEP_WIDTH];
+    uint16_t stack_pointer[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t delay_timer[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t sound_timer[CHIP8_LOCKSTEP_WIDTH];
+    // Bit i is key i, as in CHIP8_SetKeys.
+    uint16_t keys[CHIP8_LOCKSTEP_WIDTH];
+    uint32_t random_state[CHIP8_LOCKSTEP_WIDTH];
+
+    CHIP_8GFX gfx[CHIP8_LOCKSTEP_WIDTH];
+    uint64_t gfx_version[CHIP8_LOCKSTEP_WIDTH];
+
+    // 0xFF for lanes that hold an instance; only the last chunk can be partly empty.
+    uint8_t used[CHIP8_LOCKSTEP_WIDTH];
+} LockstepChunk;
+
+struct CHIP8_LOCKSTEP {
+    size_t lane_count;
+    size_t chunk_count;
+    int rom_size;
+    LockstepChunk* chunks;
+};
+
+// Select masks are 0xFF (take the new value) or 0x00 (keep the old one) per lane.
+static inline uint8_t Select8(uint8_t mask, uint8_t value, uint8_t old) {
+    return (value & mask) | (old & ~mask);
+}
+
+static inline uint16_t Select16(uint8_t mask, uint16_t value, uint16_t old) {
+    uint16_t wide = (uint16_t)(int16_t)(int8_t)mask;
+    return (value & wide) | (old & ~wide);
+}
+
+static inline uint32_t Select32(uint8_t mask, uint32_t value, uint32_t old) {
+    uint32_t wide = (uint32_t)(int32_t)(int8_t)mask;
+    return (value & wide) | (old & ~wide);
+}
+
+// 2 where the lane is selected and `taken` is set, 0 elsewhere.
+static inline uint16_t SkipAmount(uint8_t mask, uint8_t taken) {
+    return (uint16_t)(mask & taken) << 1;
+}
+
+// First selected lane, or -1.
+static int FirstLane(const uint8_t mask[CHIP8_LOCKSTEP_WIDTH]) {
+    for (int word = 0; word < CHIP8_LOCKSTEP_WIDTH; word += 8) {
+        uint64_t bytes;
+        memcpy(&bytes, mask + word, sizeof(bytes));
+
+        if (bytes == 0) {
+            continue;
+        }
+
+        for (int lane = word; lane < word + 8; lane++) {
+            if (mask[lane] != 0) {
+                return lane;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void MarkLaneRowsChanged(LockstepChunk* chunk, int lane, uint32_t rows) {
+    chunk->gfx_version[lane] += rows != 0;
+}
+
+// Per-lane versions of the Op* functions that index memory or the framebuffer.
+
+static void LaneClearScreen(LockstepChunk* chunk, int lane) {
+    uint32_t changedRows = 0;
+
+    for (uint32_t y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        changedRows |= (uint32_t)(chunk->gfx[lane].rows[y] != 0) << y;
+    }
+
+    memset(chunk->gfx[lane].rows, 0, sizeof(chunk->gfx[lane].rows));
+    MarkLaneRowsChanged(chunk, lane, changedRows);
+}
+
+static void LaneDraw(LockstepChunk* chunk, int lane, uint8_t X, uint8_t Y, uint8_t N) {
+    uint8_t Vx = chunk->v_register[X][lane];
+    uint8_t Vy = chunk->v_register[Y][lane];
+    unsigned shift = Vx % CHIP8_SCREEN_WIDTH;
+    uint64_t collision = 0;
+    uint32_t changedRows = 0;
+
+    for (uint8_t h = 0; h < N; h++) {
+        uint16_t address = (chunk->idx_register[lane] + h) & CHIP8_ADDRESS_MASK;
+        uint64_t spriteByte = chunk->memory[address][lane];
+        uint64_t sprite = RotateRight64(spriteByte << (CHIP8_SCREEN_WIDTH - 8), shift);
+        uint32_t y = (Vy + h) % CHIP8_SCREEN_HEIGHT;
+        uint64_t* row = &chunk->gfx[lane].rows[y];
+
+        collision |= *row & sprite;
+        *row ^= sprite;
+        changedRows |= (uint32_t)(sprite != 0) << y;
+    }
+
+    chunk->v_register[15][lane] = collision != 0;
+    MarkLaneRowsChanged(chunk, lane, changedRows);
+}
+
+static void LaneWriteMemory(LockstepChunk* chunk, int lane, uint16_t address, uint8_t value) {
+    chunk->memory[address & CHIP8_ADDRESS_MASK][lane] = value;
+}
+
+static void LaneRunScalar(LockstepChunk* chunk, int lane, CHIP8_OP op, uint16_t opcode) {
+    uint8_t x = OPCODE_X(opcode);
+    uint16_t idx = chunk->idx_register[lane];
+
+    switch (op) {
+        case CHIP8_OP_00E0:
+            LaneClearScreen(chunk, lane);
+            break;
+        case CHIP8_OP_00EE: {
+            uint16_t sp = chunk->stack_pointer[lane] - 1;
+            chunk->stack_pointer[lane] = sp;
+            chunk->pc_counter[lane] = chunk->stack[sp & CHIP8_STACK_MASK][lane];
+            chunk->stack[sp & CHIP8_STACK_MASK][lane] = 0;
+            break;
+        }
+        case CHIP8_OP_2NNN: {
+            uint16_t sp = chunk->stack_pointer[lane];
+            chunk->stack[sp & CHIP8_STACK_MASK][lane] = chunk->pc_counter[lane];
+            chunk->stack_pointer[lane] = sp + 1;
+            chunk->pc_counter[lane] = OPCODE_NNN(opcode);
+            break;
+        }
+        case CHIP8_OP_DXYN:
+            LaneDraw(chunk, lane, x, OPCODE_Y(opcode), OPCODE_N(opcode));
+            break;
+        case CHIP8_OP_FX0A: {
+            uint16_t keys = chunk->keys[lane];
+
+            if (keys == 0) {
+                chunk->pc_counter[lane] -= 2;
+                break;
+            }
+
+            uint8_t key = 0;
+            while (!((keys >> key) & 1)) {
+                key++;
+            }
+            chunk->v_register[x][lane] = key;
+            break;
+        }
+        case CHIP8_OP_FX33: {
+            uint8_t Vx = chunk->v_register[x][lane];
+            LaneWriteMemory(chunk, lane, idx, Vx / 100);
+            LaneWriteMemory(chunk, lane, idx + 1, (Vx / 10) % 10);
+            LaneWriteMemory(chunk, lane, idx + 2, Vx % 10);
+            break;
+        }
+        case CHIP8_OP_FX55:
+            for (uint8_t i = 0; i <= x; i++) {
+                LaneWriteMemory(chunk, lane, idx + i, chunk->v_register[i][lane]);
+            }
+            break;
+        case CHIP8_OP_FX65:
+            for (uint8_t i = 0; i <= x; i++) {
+                chunk->v_register[i][lane] = chunk->memory[(idx + i) & CHIP8_ADDRESS_MASK][lane];
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// The kernels below only read local copies of their operands and write a single chunk array, so
+// the compiler can vectorize them without having to prove the chunk's arrays don't overlap.
+
+static inline void StoreBytes(uint8_t* target, const uint8_t mask[CHIP8_LOCKSTEP_WIDTH],
+                              const uint8_t value[CHIP8_LOCKSTEP_WIDTH]) {
+    FOR_LANES(lane) { target[lane] = Select8(mask[lane], value[lane], target[lane]); }
+}
+
+static inline void StoreWords(uint16_t* target, const uint8_t mask[CHIP8_LOCKSTEP_WIDTH],
+                              const uint16_t value[CHIP8_LOCKSTEP_WIDTH]) {
+    FOR_LANES(lane) { target[lane] = Select16(mask[lane], value[lane], target[lane]); }
+}
+
+static inline void SkipWhere(uint16_t* pc, const uint8_t mask[CHIP8_LOCKSTEP_WIDTH],
+                             const uint8_t taken[CHIP8_LOCKSTEP_WIDTH]) {
+    FOR_LANES(lane) { pc[lane] += SkipAmount(mask[lane], taken[lane]); }
+}
+
+// Runs `opcode` on every lane selected by `mask`. Their pcs already point past it.
+static inline void RunGroup(LockstepChunk* chunk, const uint8_t groupMask[CHIP8_LOCKSTEP_WIDTH],
+                            uint16_t opcode) {
+    CHIP8_OP op = (CHIP8_OP)CHIP8_OpKinds[opcode];
+    uint8_t x = OPCODE_X(opcode);
+    uint8_t nn = OPCODE_NN(opcode);
+    uint16_t nnn = OPCODE_NNN(opcode);
+
+    uint8_t* Vx = chunk->v_register[x];
+    uint8_t* VF = chunk->v_register[15];
+    uint16_t* pc = chunk->pc_counter;
+
+    uint8_t vx[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t vy[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t value[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t flag[CHIP8_LOCKSTEP_WIDTH];
+    uint16_t word[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t mask[CHIP8_LOCKSTEP_WIDTH];
+
+    memcpy(mask, groupMask, sizeof(mask));
+    memcpy(vx, Vx, sizeof(vx));
+    memcpy(vy, chunk->v_register[OPCODE_Y(opcode)], sizeof(vy));
+
+    switch (op) {
+        case CHIP8_OP_1NNN:
+            FOR_LANES(lane) { word[lane] = nnn; }
+            StoreWords(pc, mask, word);
+            break;
+        case CHIP8_OP_3XNN:
+            FOR_LANES(lane) { flag[lane] = vx[lane] == nn; }
+            SkipWhere(pc, mask, flag);
+            break;
+        case CHIP8_OP_4XNN:
+            FOR_LANES(lane) { flag[lane] = vx[lane] != nn; }
+            SkipWhere(pc, mask, flag);
+            break;
+        case CHIP8_OP_5XY0:
+            FOR_LANES(lane) { flag[lane] = vx[lane] == vy[lane]; }
+            SkipWhere(pc, mask, flag);
+            break;
+        case CHIP8_OP_9XY0:
+            FOR_LANES(lane) { flag[lane] = vx[lane] != vy[lane]; }
+            SkipWhere(pc, mask, flag);
+            break;
+        case CHIP8_OP_6XNN:
+            FOR_LANES(lane) { value[lane] = nn; }
+            StoreBytes(Vx, mask, value);
+            break;
+        case CHIP8_OP_7XNN:
+            FOR_LANES(lane) { value[lane] = vx[lane] + nn; }
+            StoreBytes(Vx, mask, value);
+            break;
+        case CHIP8_OP_8XY0:
+            StoreBytes(Vx, mask, vy);
+            break;
+        case CHIP8_OP_8XY1:
+            FOR_LANES(lane) { value[lane] = vx[lane] | vy[lane]; }
+            StoreBytes(Vx, mask, value);
+            break;
+        case CHIP8_OP_8XY2:
+            FOR_LANES(lane) { value[lane] = vx[lane] & vy[lane]; }
+            StoreBytes(Vx, mask, value);
+            break;
+        case CHIP8_OP_8XY3:
+            FOR_LANES(lane) { value[lane] = vx[lane] ^ vy[lane]; }
+            StoreBytes(Vx, mask, value);
+            break;
+        // The flag-setting ones write Vx and then VF, so when X is F the flag wins.
+        case CHIP8_OP_8XY4:
+            FOR_LANES(lane) {
+                value[lane] = vx[lane] + vy[lane];
+                flag[lane] = value[lane] < vx[lane];
+            }
+            StoreBytes(Vx, mask, value);
+            StoreBytes(VF, mask, flag);
+            break;
+        case CHIP8_OP_8XY5:
+            FOR_LANES(lane) {
+                value[lane] = vx[lane] - vy[lane];
+                flag[lane] = vx[lane] >= vy[lane];
+            }
+            StoreBytes(Vx, mask, value);
+            StoreBytes(VF, mask, flag);
+            break;
+        case CHIP8_OP_8XY6:
+            FOR_LANES(lane) {
+                value[lane] = vx[lane] >> 1;
+                flag[lane] = vx[lane] & 0x01;
+            }
+            StoreBytes(Vx, mask, value);
+            StoreBytes(VF, mask, flag);
+            break;
+        case CHIP8_OP_8XY7:
+            FOR_LANES(lane) {
+                value[lane] = vy[lane] - vx[lane];
+                flag[lane] = vy[lane] >= vx[lane];
+            }
+            StoreBytes(Vx, mask, value);
+            StoreBytes(VF, mask, flag);
+            break;
+        case CHIP8_OP_8XYE:
+            FOR_LANES(lane) {
+                value[lane] = vx[lane] << 1;
+                flag[lane] = vx[lane] >> 7;
+            }
+            StoreBytes(Vx, mask, value);
+            StoreBytes(VF, mask, flag);
+            break;
+        case CHIP8_OP_ANNN:
+            FOR_LANES(lane) { word[lane] = nnn; }
+            StoreWords(chunk->idx_register, mask, word);
+            break;
+        case CHIP8_OP_BNNN:
+            memcpy(value, chunk->v_register[0], sizeof(value));
+            FOR_LANES(lane) { word[lane] = value[lane] + nnn; }
+            StoreWords(pc, mask, word);
+            break;
+        case CHIP8_OP_CXNN: {
+            // The xorshift32 of NextRandomByte, one generator per lane.
+            uint32_t random[CHIP8_LOCKSTEP_WIDTH];
+            memcpy(random, chunk->random_state, sizeof(random));
+
+            FOR_LANES(lane) {
+                uint32_t state = random[lane];
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                random[lane] = Select32(mask[lane], state, random[lane]);
+                value[lane] = (uint8_t)(state >> 24) & nn;
+            }
+
+            memcpy(chunk->random_state, random, sizeof(random));
+            StoreBytes(Vx, mask, value);
+            break;
+        }
+        case CHIP8_OP_EX9E:
+        case CHIP8_OP_EXA1: {
+            uint16_t keys[CHIP8_LOCKSTEP_WIDTH];
+            memcpy(keys, chunk->keys, sizeof(keys));
+            uint8_t skipWhen = op == CHIP8_OP_EX9E;
+
+            FOR_LANES(lane) { flag[lane] = ((keys[lane] >> (vx[lane] & 0x0F)) & 1) == skipWhen; }
+            SkipWhere(pc, mask, flag);
+            break;
+        }
+        case CHIP8_OP_FX07:
+            StoreBytes(Vx, mask, chunk->delay_timer);
+            break;
+        case CHIP8_OP_FX15:
+            StoreBytes(chunk->delay_timer, mask, vx);
+            break;
+        case CHIP8_OP_FX18:
+            StoreBytes(chunk->sound_timer, mask, vx);
+            break;
+        case CHIP8_OP_FX1E:
+            memcpy(word, chunk->idx_register, sizeof(word));
+            FOR_LANES(lane) { word[lane] += vx[lane]; }
+            StoreWords(chunk->idx_register, mask, word);
+            break;
+        case CHIP8_OP_FX29:
+            FOR_LANES(lane) { word[lane] = vx[lane] * 5; }
+            StoreWords(chunk->idx_register, mask, word);
+            break;
+        case CHIP8_OP_00E0:
+        case CHIP8_OP_00EE:
+        case CHIP8_OP_2NNN:
+        case CHIP8_OP_DXYN:
+        case CHIP8_OP_FX0A:
+        case CHIP8_OP_FX33:
+        case CHIP8_OP_FX55:
+        case CHIP8_OP_FX65:
+            FOR_LANES(lane) {
+                if (mask[lane] != 0) {
+                    LaneRunScalar(chunk, lane, op, opcode);
+                }
+            }
+            break;
+        case CHIP8_OP_NOP:
+        default:
+            break;
+    }
+}
+
+// One instruction on every lane of the chunk. Returns false once no lane can fetch anymore.
+static bool StepChunk(LockstepChunk* chunk) {
+    uint16_t pc[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t pending[CHIP8_LOCKSTEP_WIDTH];
+    uint8_t group[CHIP8_LOCKSTEP_WIDTH];
+
+    memcpy(pc, chunk->pc_counter, sizeof(pc));
+
+    // Same bounds check as the table dispatch: a lane that can't fetch stops for good.
+    FOR_LANES(lane) {
+        pending[lane] = chunk->used[lane] & -(uint8_t)(pc[lane] + 1 < CHIP8_MEMORY_SIZE);
+    }
+
+    int leader = FirstLane(pending);
+
+    if (leader < 0) {
+        return false;
+    }
+
+    do {
+        uint16_t groupPc = pc[leader];
+        const uint8_t* high = chunk->memory[groupPc];
+        const uint8_t* low = chunk->memory[groupPc + 1];
+        uint8_t opcodeHigh = high[leader];
+        uint8_t opcodeLow = low[leader];
+
+        // Regroup: every pending lane at the same pc with the same opcode bytes runs together.
+        FOR_LANES(lane) {
+            bool same = (pc[lane] == groupPc) & (high[lane] == opcodeHigh) &
+                        (low[lane] == opcodeLow);
+            group[lane] = pending[lane] & -(uint8_t)same;
+            pending[lane] &= ~group[lane];
+        }
+
+        FOR_LANES(lane) { chunk->pc_counter[lane] += group[lane] & 2; }
+
+        RunGroup(chunk, group, (uint16_t)((opcodeHigh << 8) | opcodeLow));
+
+        leader = FirstLane(pending);
+    } while (leader >= 0);
+
+    return true;
+}
+
+// Lanes of one chunk in power-on state with the ROM loaded, as CHIP8_LoadRom leaves an instance.
+static void ResetChunk(LockstepChunk* chunk, const uint8_t* romData, size_t romSize) {
+    for (uint16_t address = 0; address < CHIP8_FONT_SIZE; address++) {
+        memset(chunk->memory[address], CHIP8_FontData[address], CHIP8_LOCKSTEP_WIDTH);
+    }
+
+    for (size_t i = 0; i < romSize; i++) {
+        memset(chunk->memory[CHIP8_PROGRAM_START + i], romData[i], CHIP8_LOCKSTEP_WIDTH);
+    }
+
+    FOR_LANES(lane) {
+        chunk->pc_counter[lane] = CHIP8_PROGRAM_START;
+        chunk->random_state[lane] = CHIP8_DEFAULT_RANDOM_SEED;
+        chunk->gfx_version[lane] = 1;
+    }
+}
+
+CHIP8_LOCKSTEP* CHIP8_CreateLockstep(const uint8_t* romData, size_t romSize, size_t lanes) {
+    if (romData == NULL || romSize > CHIP8_MAX_ROM_SIZE || lanes == 0) {
+        return NULL;
+    }
+
+    CHIP8_LOCKSTEP* lockstep = (CHIP8_LOCKSTEP*)calloc(1, sizeof(CHIP8_LOCKSTEP));
+
+    if (lockstep == NULL) {
+        return NULL;
+    }
+
+    lockstep->lane_count = lanes;
+    lockstep->chunk_count = (lanes + CHIP8_LOCKSTEP_WIDTH - 1) / CHIP8_LOCKSTEP_WIDTH;
+    lockstep->rom_size = (int)romSize;
+    lockstep->chunks = (LockstepChunk*)calloc(lockstep->chunk_count, sizeof(LockstepChunk));
+
+    if (lockstep->chunks == NULL) {
+        free(lockstep);
+        return NULL;
+    }
+
+    CHIP8_InitDispatchTables();
+
+    for (size_t c = 0; c < lockstep->chunk_count; c++) {
+        ResetChunk(&lockstep->chunks[c], romData, romSize);
+    }
+
+    for (size_t lane = 0; lane < lanes; lane++) {
+        lockstep->chunks[lane / CHIP8_LOCKSTEP_WIDTH].used[lane % CHIP8_LOCKSTEP_WIDTH] = 0xFF;
+    }
+
+    return lockstep;
+}
+
+void CHIP8_DestroyLockstep(CHIP8_LOCKSTEP* lockstep) {
+    if (lockstep == NULL) {
+        return;
+    }
+
+    free(lockstep->chunks);
+    free(lockstep);
+}
+
+size_t CHIP8_GetLockstepLaneCount(const CHIP8_LOCKSTEP* lockstep) { return lockstep->lane_count; }
+
+void CHIP8_RunLockstepCycles(CHIP8_LOCKSTEP* lockstep, uint32_t cycles) {
+    // Lanes never interact, so each chunk runs the whole budget while its state is in cache.
+    for (size_t c = 0; c < lockstep->chunk_count; c++) {
+        for (uint32_t i = 0; i < cycles && StepChunk(&lockstep->chunks[c]); i++) {
+        }
+    }
+}
+
+void CHIP8_DecreaseLockstepTimers(CHIP8_LOCKSTEP* lockstep) {
+    for (size_t c = 0; c < lockstep->chunk_count; c++) {
+        LockstepChunk* chunk = &lockstep->chunks[c];
+
+        FOR_LANES(lane) {
+            chunk->delay_timer[lane] -= chunk->delay_timer[lane] > 0;
+            chunk->sound_timer[lane] -= chunk->sound_timer[lane] > 0;
+        }
+    }
+}
+
+// The chunk and slot holding `lane`.
+#define LANE_CHUNK(lockstep, lane) (&(lockstep)->chunks[(lane) / CHIP8_LOCKSTEP_WIDTH])
+#define LANE_SLOT(lane) ((lane) % CHIP8_LOCKSTEP_WIDTH)
+
+void CHIP8_SetLockstepKeys(CHIP8_LOCKSTEP* lockstep, size_t lane, uint16_t keyMask) {
+    LANE_CHUNK(lockstep, lane)->keys[LANE_SLOT(lane)] = keyMask;
+}
+
+void CHIP8_SetLockstepRandomSeed(CHIP8_LOCKSTEP* lockstep, size_t lane, uint32_t seed) {
+    // Same remapping as CHIP8_SetRandomSeed.
+    LANE_CHUNK(lockstep, lane)->random_state[LANE_SLOT(lane)] =
+        seed != 0 ? seed : CHIP8_DEFAULT_RANDOM_SEED;
+}
+
+const CHIP_8GFX* CHIP8_GetLockstepGFX(const CHIP8_LOCKSTEP* lockstep, size_t lane) {
+    return &LANE_CHUNK(lockstep, lane)->gfx[LANE_SLOT(lane)];
+}
+
+void CHIP8_CopyLockstepLane(const CHIP8_LOCKSTEP* lockstep, size_t lane, CHIP8* chip8) {
+    const LockstepChunk* chunk = LANE_CHUNK(lockstep, lane);
+    int slot = LANE_SLOT(lane);
+
+    CHIP8_Reset(chip8);
+
+    for (uint16_t address = 0; address < CHIP8_MEMORY_SIZE; address++) {
+        chip8->memory[address] = chunk->memory[address][slot];
+    }
+
+    for (int i = 0; i < CHIP8_REGISTERS; i++) {
+        chip8->v_register[i] = chunk->v_register[i][slot];
+    }
+
+    for (int i = 0; i < CHIP8_STACK_SIZE; i++) {
+        chip8->stack[i] = chunk->stack[i][slot];
+    }
+
+    CHIP8_SetKeys(chip8, chunk->keys[slot]);
+
+    chip8->gfx = chunk->gfx[slot];
+    chip8->gfx_dirty_rows = CHIP8_ALL_ROWS;
+    // Never behind what the instance already handed out, so observers still see a new frame.
+    chip8->gfx_version += chunk->gfx_version[slot];
+
+    chip8->delay_timer = chunk->delay_timer[slot];
+    chip8->sound_timer = chunk->sound_timer[slot];
+    chip8->idx_register = chunk->idx_register[slot];
+    chip8->pc_counter = chunk->pc_counter[slot];
+    chip8->stack_pointer = chunk->stack_pointer[slot];
+    chip8->rom_size = lockstep->rom_size;
+    chip8->random_state = chunk->random_state[slot];
+
+    // Memory was written behind WriteMemory's back.
+    CHIP8_InvalidateDecodeCache(chip8);
+}
@@ -0,0 +1,251 @@
+#include "chip8_internal.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Table dispatch: every possible 16-bit opcode maps straight to its handler, so executing an
+// instruction is one fetch, one load and one indirect call instead of the nested switches in
+// DecodeInstruction. Operand extraction is left to the handler since it's just shifts and masks.
+
+typedef void (*OpcodeHandler)(CHIP8* chip8, uint16_t opcode);
+
+static void HandleNop(CHIP8* chip8, uint16_t opcode) {
+    (void)chip8;
+    (void)opcode;
+}
+
+static void Handle00E0(CHIP8* chip8, uint16_t opcode) {
+    (void)opcode;
+    Op00E0(chip8);
+}
+
+static void Handle00EE(CHIP8* chip8, uint16_t opcode) {
+    (void)opcode;
+    Op00EE(chip8);
+}
+
+static void Handle1NNN(CHIP8* chip8, uint16_t opcode) { Op1NNN(chip8, OPCODE_NNN(opcode)); }
+static void Handle2NNN(CHIP8* chip8, uint16_t opcode) { Op2NNN(chip8, OPCODE_NNN(opcode)); }
+static void Handle3XNN(CHIP8* chip8, uint16_t opcode) {
+    Op3XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+}
+static void Handle4XNN(CHIP8* chip8, uint16_t opcode) {
+    Op4XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+}
+static void Handle5XY0(CHIP8* chip8, uint16_t opcode) {
+    Op5XY0(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle6XNN(CHIP8* chip8, uint16_t opcode) {
+    Op6XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+}
+static void Handle7XNN(CHIP8* chip8, uint16_t opcode) {
+    Op7XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+}
+static void Handle8XY0(CHIP8* chip8, uint16_t opcode) {
+    Op8XY0(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XY1(CHIP8* chip8, uint16_t opcode) {
+    Op8XY1(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XY2(CHIP8* chip8, uint16_t opcode) {
+    Op8XY2(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XY3(CHIP8* chip8, uint16_t opcode) {
+    Op8XY3(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XY4(CHIP8* chip8, uint16_t opcode) {
+    Op8XY4(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XY5(CHIP8* chip8, uint16_t opcode) {
+    Op8XY5(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XY6(CHIP8* chip8, uint16_t opcode) { Op8XY6(chip8, OPCODE_X(opcode)); }
+static void Handle8XY7(CHIP8* chip8, uint16_t opcode) {
+    Op8XY7(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void Handle8XYE(CHIP8* chip8, uint16_t opcode) { Op8XYE(chip8, OPCODE_X(opcode)); }
+static void Handle9XY0(CHIP8* chip8, uint16_t opcode) {
+    Op9XY0(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+}
+static void HandleANNN(CHIP8* chip8, uint16_t opcode) { OpANNN(chip8, OPCODE_NNN(opcode)); }
+static void HandleBNNN(CHIP8* chip8, uint16_t opcode) { OpBNNN(chip8, OPCODE_NNN(opcode)); }
+static void HandleCXNN(CHIP8* chip8, uint16_t opcode) {
+    OpCXNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+}
+static void HandleDXYN(CHIP8* chip8, uint16_t opcode) {
+    OpDXYN(chip8, OPCODE_X(opcode), OPCODE_Y(opcode), OPCODE_N(opcode));
+}
+static void HandleEX9E(CHIP8* chip8, uint16_t opcode) { OpEX9E(chip8, OPCODE_X(opcode)); }
+static void HandleEXA1(CHIP8* chip8, uint16_t opcode) { OpEXA1(chip8, OPCODE_X(opcode)); }
+static void HandleFX07(CHIP8* chip8, uint16_t opcode) { OpFX07(chip8, OPCODE_X(opcode)); }
+static void HandleFX0A(CHIP8* chip8, uint16_t opcode) { OpFX0A(chip8, OPCODE_X(opcode)); }
+static void HandleFX15(CHIP8* chip8, uint16_t opcode) { OpFX15(chip8, OPCODE_X(opcode)); }
+static void HandleFX18(CHIP8* chip8, uint16_t opcode) { OpFX18(chip8, OPCODE_X(opcode)); }
+static void HandleFX1E(CHIP8* chip8, uint16_t opcode) { OpFX1E(chip8, OPCODE_X(opcode)); }
+static void HandleFX29(CHIP8* chip8, uint16_t opcode) { OpFX29(chip8, OPCODE_X(opcode)); }
+static void HandleFX33(CHIP8* chip8, uint16_t opcode) { OpFX33(chip8, OPCODE_X(opcode)); }
+static void HandleFX55(CHIP8* chip8, uint16_t opcode) { OpFX55(chip8, OPCODE_X(opcode)); }
+static void HandleFX65(CHIP8* chip8, uint16_t opcode) { OpFX65(chip8, OPCODE_X(opcode)); }
+
+// Indexed by CHIP8_OP.
+static const OpcodeHandler OpHandlers[CHIP8_OP_COUNT] = {
+    [CHIP8_OP_NOP] = HandleNop,   [CHIP8_OP_00E0] = Handle00E0, [CHIP8_OP_00EE] = Handle00EE,
+    [CHIP8_OP_1NNN] = Handle1NNN, [CHIP8_OP_2NNN] = Handle2NNN, [CHIP8_OP_3XNN] = Handle3XNN,
+    [CHIP8_OP_4XNN] = Handle4XNN, [CHIP8_OP_5XY0] = Handle5XY0, [CHIP8_OP_6XNN] = Handle6XNN,
+    [CHIP8_OP_7XNN] = Handle7XNN, [CHIP8_OP_8XY0] = Handle8XY0, [CHIP8_OP_8XY1] = Handle8XY1,
+    [CHIP8_OP_8XY2] = Handle8XY2, [CHIP8_OP_8XY3] = Handle8XY3, [CHIP8_OP_8XY4] = Handle8XY4,
+    [CHIP8_OP_8XY5] = Handle8XY5, [CHIP8_OP_8XY6] = Handle8XY6, [CHIP8_OP_8XY7] = Handle8XY7,
+    [CHIP8_OP_8XYE] = Handle8XYE, [CHIP8_OP_9XY0] = Handle9XY0, [CHIP8_OP_ANNN] = HandleANNN,
+    [CHIP8_OP_BNNN] = HandleBNNN, [CHIP8_OP_CXNN] = HandleCXNN, [CHIP8_OP_DXYN] = HandleDXYN,
+    [CHIP8_OP_EX9E] = HandleEX9E, [CHIP8_OP_EXA1] = HandleEXA1, [CHIP8_OP_FX07] = HandleFX07,
+    [CHIP8_OP_FX0A] = HandleFX0A, [CHIP8_OP_FX15] = HandleFX15, [CHIP8_OP_FX18] = HandleFX18,
+    [CHIP8_OP_FX1E] = HandleFX1E, [CHIP8_OP_FX29] = HandleFX29, [CHIP8_OP_FX33] = HandleFX33,
+    [CHIP8_OP_FX55] = HandleFX55, [CHIP8_OP_FX65] = HandleFX65,
+};
+
+static OpcodeHandler OpcodeTable[0x10000];
+uint8_t CHIP8_OpKinds[0x10000];
+
+// Mirrors DecodeInstruction exactly, including what it ignores (0NNN machine calls, the low
+// nibble of 5XY0/9XY0), so every dispatch mode runs a ROM the same way.
+CHIP8_OP CHIP8_DecodeOp(uint16_t opcode) {
+    switch (opcode >> 12) {
+        case 0x0:
+            switch (OPCODE_NN(opcode)) {
+                case 0xE0:
+                    return CHIP8_OP_00E0;
+                case 0xEE:
+                    return CHIP8_OP_00EE;
+            }
+            return CHIP8_OP_NOP;
+        case 0x1:
+            return CHIP8_OP_1NNN;
+        case 0x2:
+            return CHIP8_OP_2NNN;
+        case 0x3:
+            return CHIP8_OP_3XNN;
+        case 0x4:
+            return CHIP8_OP_4XNN;
+        case 0x5:
+            return CHIP8_OP_5XY0;
+        case 0x6:
+            return CHIP8_OP_6XNN;
+        case 0x7:
+            return CHIP8_OP_7XNN;
+        case 0x8:
+            switch (OPCODE_N(opcode)) {
+                case 0x0:
+                    return CHIP8_OP_8XY0;
+                case 0x1:
+                    return CHIP8_OP_8XY1;
+                case 0x2:
+                    return CHIP8_OP_8XY2;
+                case 0x3:
+                    return CHIP8_OP_8XY3;
+                case 0x4:
+                    return CHIP8_OP_8XY4;
+                case 0x5:
+                    return CHIP8_OP_8XY5;
+                case 0x6:
+                    return CHIP8_OP_8XY6;
+                case 0x7:
+                    return CHIP8_OP_8XY7;
+                case 0xE:
+                    return CHIP8_OP_8XYE;
+            }
+            return CHIP8_OP_NOP;
+        case 0x9:
+            return CHIP8_OP_9XY0;
+        case 0xA:
+            return CHIP8_OP_ANNN;
+        case 0xB:
+            return CHIP8_OP_BNNN;
+        case 0xC:
+            return CHIP8_OP_CXNN;
+        case 0xD:
+            return CHIP8_OP_DXYN;
+        case 0xE:
+            switch (OPCODE_NN(opcode)) {
+                case 0x9E:
+                    return CHIP8_OP_EX9E;
+                case 0xA1:
+                    return CHIP8_OP_EXA1;
+            }
+            return CHIP8_OP_NOP;
+        case 0xF:
+            switch (OPCODE_NN(opcode)) {
+                case 0x07:
+                    return CHIP8_OP_FX07;
+                case 0x0A:
+                    return CHIP8_OP_FX0A;
+                case 0x15:
+                    return CHIP8_OP_FX15;
+                case 0x18:
+                    return CHIP8_OP_FX18;
+                case 0x1E:
+                    return CHIP8_OP_FX1E;
+                case 0x29:
+                    return CHIP8_OP_FX29;
+                case 0x33:
+                    return CHIP8_OP_FX33;
+                case 0x55:
+                    return CHIP8_OP_FX55;
+                case 0x65:
+                    return CHIP8_OP_FX65;
+            }
+            return CHIP8_OP_NOP;
+    }
+
+    return CHIP8_OP_NOP;
+}
+
+static void BuildOpcodeTable() {
+    for (uint32_t opcode = 0; opcode < 0x10000; opcode++) {
+        CHIP8_OP op = CHIP8_DecodeOp((uint16_t)opcode);
+        CHIP8_OpKinds[opcode] = (uint8_t)op;
+        OpcodeTable[opcode] = OpHandlers[op];
+    }
+}
+
+// The table is shared by every instance, and instances may be created from several threads.
+#if defined(_WIN32)
+static INIT_ONCE OpcodeTableOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK BuildOpcodeTableOnce(PINIT_ONCE once, PVOID parameter, PVOID* context) {
+    (void)once;
+    (void)parameter;
+    (void)context;
+    BuildOpcodeTable();
+    return TRUE;
+}
+
+void CHIP8_InitDispatchTables() {
+    InitOnceExecuteOnce(&OpcodeTableOnce, BuildOpcodeTableOnce, NULL, NULL);
+}
+#else
+static pthread_once_t OpcodeTableOnce = PTHREAD_ONCE_INIT;
+
+void CHIP8_InitDispatchTables() { pthread_once(&OpcodeTableOnce, BuildOpcodeTable); }
+#endif
+
+void CHIP8_ExecuteOpcode(CHIP8* chip8, uint16_t opcode) { OpcodeTable[opcode](chip8, opcode); }
+
+void CHIP8_RunTableDispatch(CHIP8* chip8, uint32_t cycles) {
+    for (uint32_t i = 0; i < cycles; i++) {
+        uint16_t pc = chip8->pc_counter;
+
+        if (pc + 1 >= CHIP8_MEMORY_SIZE) {
+            return;
+        }
+
+        uint16_t opcode = (chip8->memory[pc] << 8) | chip8->memory[pc + 1];
+        chip8->pc_counter = pc + 2;
+
+        OpcodeTable[opcode](chip8, opcode);
+    }
+}
@@ -0,0 +1,156 @@
+#include "chip8_internal.h"
+#include <stdint.h>
+
+// Threaded-code interpreter: every handler ends by fetching and jumping straight to the next
+// one, so each instruction gets its own indirect branch site and the predictor can learn the
+// ROM's instruction sequences instead of funnelling everything through one dispatch point.
+//
+// Needs labels-as-values, which GCC and Clang both support. Elsewhere the threaded mode runs on
+// the DecodeInstruction switch instead.
+
+#if defined(__GNUC__) || defined(__clang__)
+
+void CHIP8_RunThreadedDispatch(CHIP8* chip8, uint32_t cycles) {
+    // Indexed by CHIP8_OP.
+    static void* const Labels[CHIP8_OP_COUNT] = {
+        [CHIP8_OP_NOP] = &&op_NOP,   [CHIP8_OP_00E0] = &&op_00E0, [CHIP8_OP_00EE] = &&op_00EE,
+        [CHIP8_OP_1NNN] = &&op_1NNN, [CHIP8_OP_2NNN] = &&op_2NNN, [CHIP8_OP_3XNN] = &&op_3XNN,
+        [CHIP8_OP_4XNN] = &&op_4XNN, [CHIP8_OP_5XY0] = &&op_5XY0, [CHIP8_OP_6XNN] = &&op_6XNN,
+        [CHIP8_OP_7XNN] = &&op_7XNN, [CHIP8_OP_8XY0] = &&op_8XY0, [CHIP8_OP_8XY1] = &&op_8XY1,
+        [CHIP8_OP_8XY2] = &&op_8XY2, [CHIP8_OP_8XY3] = &&op_8XY3, [CHIP8_OP_8XY4] = &&op_8XY4,
+        [CHIP8_OP_8XY5] = &&op_8XY5, [CHIP8_OP_8XY6] = &&op_8XY6, [CHIP8_OP_8XY7] = &&op_8XY7,
+        [CHIP8_OP_8XYE] = &&op_8XYE, [CHIP8_OP_9XY0] = &&op_9XY0, [CHIP8_OP_ANNN] = &&op_ANNN,
+        [CHIP8_OP_BNNN] = &&op_BNNN, [CHIP8_OP_CXNN] = &&op_CXNN, [CHIP8_OP_DXYN] = &&op_DXYN,
+        [CHIP8_OP_EX9E] = &&op_EX9E, [CHIP8_OP_EXA1] = &&op_EXA1, [CHIP8_OP_FX07] = &&op_FX07,
+        [CHIP8_OP_FX0A] = &&op_FX0A, [CHIP8_OP_FX15] = &&op_FX15, [CHIP8_OP_FX18] = &&op_FX18,
+        [CHIP8_OP_FX1E] = &&op_FX1E, [CHIP8_OP_FX29] = &&op_FX29, [CHIP8_OP_FX33] = &&op_FX33,
+        [CHIP8_OP_FX55] = &&op_FX55, [CHIP8_OP_FX65] = &&op_FX65,
+    };
+
+    uint32_t remaining = cycles;
+    uint16_t opcode;
+
+// Same fetch and bounds check as FetchNextInstruction, expanded at the end of every handler.
+#define DISPATCH()                                                                                 \
+    do {                                                                                           \
+        uint16_t pc = chip8->pc_counter;                                                           \
+        if (remaining == 0 || pc + 1 >= CHIP8_MEMORY_SIZE) {                                       \
+            return;                                                                                \
+        }                                                                                          \
+        remaining -= 1;                                                                            \
+        opcode = (chip8->memory[pc] << 8) | chip8->memory[pc + 1];                                 \
+        chip8->pc_counter = pc + 2;                                                                \
+        goto *Labels[CHIP8_OpKinds[opcode]];                                                       \
+    } while (0)
+
+    DISPATCH();
+
+op_NOP:
+    DISPATCH();
+op_00E0:
+    Op00E0(chip8);
+    DISPATCH();
+op_00EE:
+    Op00EE(chip8);
+    DISPATCH();
+op_1NNN:
+    Op1NNN(chip8, OPCODE_NNN(opcode));
+    DISPATCH();
+op_2NNN:
+    Op2NNN(chip8, OPCODE_NNN(opcode));
+    DISPATCH();
+op_3XNN:
+    Op3XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+    DISPATCH();
+op_4XNN:
+    Op4XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+    DISPATCH();
+op_5XY0:
+    Op5XY0(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_6XNN:
+    Op6XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+    DISPATCH();
+op_7XNN:
+    Op7XNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+    DISPATCH();
+op_8XY0:
+    Op8XY0(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XY1:
+    Op8XY1(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XY2:
+    Op8XY2(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XY3:
+    Op8XY3(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XY4:
+    Op8XY4(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XY5:
+    Op8XY5(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XY6:
+    Op8XY6(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_8XY7:
+    Op8XY7(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_8XYE:
+    Op8XYE(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_9XY0:
+    Op9XY0(chip8, OPCODE_X(opcode), OPCODE_Y(opcode));
+    DISPATCH();
+op_ANNN:
+    OpANNN(chip8, OPCODE_NNN(opcode));
+    DISPATCH();
+op_BNNN:
+    OpBNNN(chip8, OPCODE_NNN(opcode));
+    DISPATCH();
+op_CXNN:
+    OpCXNN(chip8, OPCODE_X(opcode), OPCODE_NN(opcode));
+    DISPATCH();
+op_DXYN:
+    OpDXYN(chip8, OPCODE_X(opcode), OPCODE_Y(opcode), OPCODE_N(opcode));
+    DISPATCH();
+op_EX9E:
+    OpEX9E(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_EXA1:
+    OpEXA1(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX07:
+    OpFX07(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX0A:
+    OpFX0A(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX15:
+    OpFX15(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX18:
+    OpFX18(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX1E:
+    OpFX1E(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX29:
+    OpFX29(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX33:
+    OpFX33(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX55:
+    OpFX55(chip8, OPCODE_X(opcode));
+    DISPATCH();
+op_FX65:
+    OpFX65(chip8, OPCODE_X(opcode));
+    DISPATCH();
+
+#undef DISPATCH
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include "compositor.h"
+#include <string.h>
+
+typedef struct RomCompositeMode {
+    const char* fileName;
+    COMPOSITE_MODE mode;
+} RomCompositeMode;
+
+static const char* CompositeModeNames[COMPOSITE_MODE_COUNT] = {
+    [COMPOSITE_MODE_OFF] = "off",
+    [COMPOSITE_MODE_OR] = "or",
+    [COMPOSITE_MODE_BLEND] = "blend",
+};
+
+// Bundled ROMs whose moving sprites flicker.
+static const RomCompositeMode DefaultModes[] = {
+    {"pong.rom", COMPOSITE_MODE_BLEND},
+    {"Breakout1979.ch8", COMPOSITE_MODE_BLEND},
+};
+
+static const char* GetPathFileName(const char* path) {
+    const char* name = path;
+
+    for (const char* c = path; *c != '\0'; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+
+    return name;
+}
+
+const char* GetCompositeModeName(COMPOSITE_MODE mode) {
+    return (unsigned)mode < COMPOSITE_MODE_COUNT ? CompositeModeNames[mode]
+                                                 : CompositeModeNames[0];
+}
+
+COMPOSITE_MODE GetDefaultCompositeMode(const char* romPath) {
+    const char* fileName = GetPathFileName(romPath);
+
+    for (size_t i = 0; i < sizeof(DefaultModes) / sizeof(DefaultModes[0]); i++) {
+        if (strcmp(fileName, DefaultModes[i].fileName) == 0) {
+            return DefaultModes[i].mode;
+        }
+    }
+
+    return COMPOSITE_MODE_OFF;
+}
+
+void SetCompositeMode(Compositor* compositor, COMPOSITE_MODE mode) {
+    if (compositor->mode != mode) {
+        compositor->mode = mode;
+        compositor->isDirty = true;
+    }
+}
+
+static const CHIP_8GFX* GetFrame(const Compositor* compositor, int age) {
+    return &compositor->frames[(compositor->newest + COMPOSITOR_FRAMES - age) % COMPOSITOR_FRAMES];
+}
+
+static void BuildLayers(Compositor* compositor) {
+    bool isBlend = compositor->mode == COMPOSITE_MODE_BLEND;
+    int depth = compositor->mode == COMPOSITE_MODE_OFF ? 1 : COMPOSITOR_FRAMES;
+
+    compositor->layerCount = isBlend ? depth : 1;
+    compositor->layers[0] = *GetFrame(compositor, 0);
+
+    // Blend keeps every partial OR as its own layer; OR folds them all into layer 0.
+    for (int age = 1; age < depth; age++) {
+        const CHIP_8GFX* older = GetFrame(compositor, age);
+        const CHIP_8GFX* newer = &compositor->layers[isBlend ? age - 1 : 0];
+        CHIP_8GFX* layer = &compositor->layers[isBlend ? age : 0];
+
+        for (int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+            layer->rows[y] = newer->rows[y] | older->rows[y];
+        }
+    }
+}
+
+void PushCompositeFrame(Compositor* compositor, const CHIP_8GFX* gfx, uint64_t version) {
+    // The same frame shown again (a display faster than 60 Hz, vsync jitter, frame skip or
+    // run-ahead holding the screen) must not take a slot from an older emulated frame.
+    if (version == compositor->frameVersions[compositor->newest]) {
+        if (compositor->isDirty) {
+            BuildLayers(compositor);
+            compositor->isDirty = false;
+            compositor->version++;
+        }
+
+        return;
+    }
+
+    compositor->newest = (compositor->newest + 1) % COMPOSITOR_FRAMES;
+    compositor->frames[compositor->newest] = *gfx;
+    compositor->frameVersions[compositor->newest] = version;
+
+    BuildLayers(compositor);
+    compositor->isDirty = false;
+    compositor->version++;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Emulated frames the compositor remembers, the one shown now included.
+#define COMPOSITOR_FRAMES 3
+
+// Games that move sprites by XOR-erasing and redrawing them show each sprite only on some frames.
+// Combining the last few frames hides that flicker without running the display any faster.
+typedef enum {
+    COMPOSITE_MODE_OFF,
+    // A pixel lit in any of the last COMPOSITOR_FRAMES frames is lit.
+    COMPOSITE_MODE_OR,
+    // As OR, but a pixel dims the longer ago it was last lit.
+    COMPOSITE_MODE_BLEND,
+    COMPOSITE_MODE_COUNT,
+} COMPOSITE_MODE;
+
+// The last COMPOSITOR_FRAMES frames and the image built from them, as `layerCount` nested 1-bit
+// layers. OR and off have one layer. Blend has one per frame: layers[i] is the OR of the newest
+// i + 1 frames, so a pixel's brightness is the number of layers it is lit in over layerCount.
+typedef struct Compositor {
+    COMPOSITE_MODE mode;
+    bool isDirty;
+
+    // Ring of the pushed frames; frames[newest] is the latest.
+    CHIP_8GFX frames[COMPOSITOR_FRAMES];
+    uint64_t frameVersions[COMPOSITOR_FRAMES];
+    int newest;
+
+    int layerCount;
+    CHIP_8GFX layers[COMPOSITOR_FRAMES];
+    // Goes up whenever the layers change, so caches can key on it like a framebuffer version.
+    uint64_t version;
+} Compositor;
+
+const char* GetCompositeModeName(COMPOSITE_MODE mode);
+// The mode a ROM gets until it's picked by hand: on for bundled games known to flicker, off
+// otherwise. Matched on the file name.
+COMPOSITE_MODE GetDefaultCompositeMode(const char* romPath);
+
+void SetCompositeMode(Compositor* compositor, COMPOSITE_MODE mode);
+// Adds an emulated frame, CHIP8_GetFramebufferVersion `version`, and rebuilds the layers. Meant to
+// be called every display frame: a version equal to the newest one is the same frame shown again
+// and leaves the ring alone, so the layers cover the last COMPOSITOR_FRAMES emulated frames that
+// changed the screen whatever the display rate. A handful of word operations per row.
+void PushCompositeFrame(Compositor* compositor, const CHIP_8GFX* gfx, uint64_t version);
@@ -0,0 +1,650 @@
+#if !defined(_WIN32)
+// clock_gettime and nanosleep under -std=c17.
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "emulation.h"
+#include "movie.h"
+#include "rewind.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Ten minutes of frames at 60 FPS need 1.5-5.5 MB for the bundled ROMs.
+#define REWIND_BUFFER_BYTES (8u << 20)
+#define MOVIE_FILE "movie.c8m"
+// Wall time turbo runs between publishing a frame and looking at new commands.
+#define TURBO_SLICE 0.004
+// How often the turbo speed readout is updated.
+#define TURBO_REPORT_INTERVAL 0.5
+#define COMMAND_QUEUE_SIZE 16
+// Set on the triple buffer's middle index when it holds a frame the render thread hasn't taken.
+#define FRESH_FRAME 4u
+
+// The render thread and the emulation thread only share words through these. MSVC's C mode has no
+// <stdatomic.h>; its Interlocked functions are full barriers, which is more than enough.
+#if defined(_MSC_VER)
+typedef volatile LONG AtomicWord;
+static uint32_t AtomicLoad(AtomicWord* word) {
+    return (uint32_t)InterlockedCompareExchange(word, 0, 0);
+}
+static void AtomicStore(AtomicWord* word, uint32_t value) {
+    InterlockedExchange(word, (LONG)value);
+}
+static uint32_t AtomicExchange(AtomicWord* word, uint32_t value) {
+    return (uint32_t)InterlockedExchange(word, (LONG)value);
+}
+#else
+#include <stdatomic.h>
+typedef _Atomic uint32_t AtomicWord;
+static uint32_t AtomicLoad(AtomicWord* word) {
+    return atomic_load_explicit(word, memory_order_acquire);
+}
+static void AtomicStore(AtomicWord* word, uint32_t value) {
+    atomic_store_explicit(word, value, memory_order_release);
+}
+static uint32_t AtomicExchange(AtomicWord* word, uint32_t value) {
+    return atomic_exchange_explicit(word, value, memory_order_acq_rel);
+}
+#endif
+
+typedef enum {
+    RUN_MODE_NORMAL,
+    RUN_MODE_STEP,
+} RUN_MODE;
+
+// Triple buffer: the emulation thread fills Frames[BackFrame] and swaps it with the middle slot,
+// the render thread swaps the middle slot with Frames[FrontFrame] when it is fresh. Neither side
+// ever waits, and the render thread always ends up with the newest complete frame.
+static EmulationFrame Frames[3];
+static uint32_t BackFrame = 1;
+static AtomicWord MiddleFrame = 2;
+static uint32_t FrontFrame = 0;
+
+// Single-producer, single-consumer ring; the indices only ever grow and wrap at 2^32.
+static EmulationCommand Commands[COMMAND_QUEUE_SIZE];
+static AtomicWord CommandHead = 0;
+static AtomicWord CommandTail = 0;
+
+static AtomicWord Controls = 0;
+static AtomicWord Running = 0;
+
+#if defined(_WIN32)
+static HANDLE Thread = NULL;
+#else
+static pthread_t Thread;
+#endif
+
+// Everything below belongs to the emulation thread once it has started.
+static RUN_MODE CurrentRunMode = RUN_MODE_NORMAL;
+static CHIP8* Emulator = NULL;
+static char CurrentRomPath[EMULATION_MAX_ROM_PATH];
+
+// One quick save slot, kept in memory only.
+static CHIP8_STATE QuickSave;
+static bool HasQuickSave = false;
+
+// Runs the machine at the chosen instructions per second whatever the display rate.
+static Scheduler Clock = {0};
+
+// Rewinding plays the recorded frames backwards at one per 1/60 s.
+static RewindBuffer* Rewind = NULL;
+static bool IsRewinding = false;
+static double RewindOwedFrames = 0.0;
+
+// Recording always starts from a fresh boot of the current ROM.
+static MOVIE_MODE CurrentMovieMode = MOVIE_MODE_OFF;
+static Movie* CurrentMovie = NULL;
+static uint32_t MovieFrame = 0;
+static uint32_t MovieDesyncs = 0;
+
+// Turbo emulates whole 1/60 s frames back to back instead of keeping to the clock.
+static bool IsTurbo = false;
+static double TurboSpeed = 0.0;
+static double TurboWindowStart = 0.0;
+static uint32_t TurboWindowFrames = 0;
+
+// Frames shown ahead of the real state. Games that read keys once per game loop react on screen
+// that many frames sooner.
+static int RunAheadFrames = 0;
+static double RunAheadCost = 0.0;
+// The last speculative screen published and the version it went out with. Putting the real state
+// back bumps the framebuffer version, so every speculation ends on a new version even when it
+// draws the same screen; reusing this one keeps the render thread's version caches hitting.
+static CHIP_8GFX AheadGfx;
+static uint64_t AheadVersion = 0;
+
+// Something the render thread hasn't seen yet: a finished frame, a jump or a status change.
+static bool HasNewFrame = false;
+
+#if defined(_WIN32)
+static double NowSeconds() {
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+static void SleepSeconds(double seconds) { Sleep((DWORD)(seconds * 1000.0)); }
+#else
+static double NowSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void SleepSeconds(double seconds) {
+    struct timespec duration = {.tv_sec = 0, .tv_nsec = (long)(seconds * 1e9)};
+    nanosleep(&duration, NULL);
+}
+#endif
+
+static uint16_t ReadKeypad() { return (uint16_t)(AtomicLoad(&Controls) & EMULATION_KEYS); }
+
+static int LoadRom(const char* romPath) {
+    if (CHIP8_LoadGameIntoMemory(Emulator, romPath) != 0) {
+        return -1;
+    }
+
+    snprintf(CurrentRomPath, sizeof(CurrentRomPath), "%s", romPath);
+    ClearRewindBuffer(Rewind);
+    return 0;
+}
+
+// Reloads the current ROM so a movie starts from power-on with a known seed.
+static bool RestartRom(uint32_t seed) {
+    if (CHIP8_LoadGameIntoMemory(Emulator, CurrentRomPath) != 0) {
+        return false;
+    }
+
+    CHIP8_SetRandomSeed(Emulator, seed);
+    ClearRewindBuffer(Rewind);
+    ResetScheduler(&Clock, Clock.instructionsPerSecond, NowSeconds());
+    return true;
+}
+
+static void StopMovie() {
+    if (CurrentMovieMode == MOVIE_MODE_RECORD) {
+        SaveMovie(CurrentMovie, MOVIE_FILE);
+    }
+
+    CurrentMovieMode = MOVIE_MODE_OFF;
+}
+
+static void StartRecording() {
+    uint32_t seed = (uint32_t)time(NULL);
+
+    if (RestartRom(seed) &&
+        BeginMovieRecording(CurrentMovie, Emulator, CurrentRomPath, seed,
+                            Clock.instructionsPerSecond) == 0) {
+        CurrentMovieMode = MOVIE_MODE_RECORD;
+    }
+}
+
+static void StartPlayback() {
+    // A movie only replays on the ROM it was recorded with, at the speed it was recorded at.
+    if (LoadMovie(CurrentMovie, MOVIE_FILE) != 0 ||
+        !MovieMatchesRom(CurrentMovie, CurrentRomPath)) {
+        return;
+    }
+
+    Clock.instructionsPerSecond = GetMovieInstructionsPerSecond(CurrentMovie);
+
+    if (RestartRom(GetMovieSeed(CurrentMovie)) && SeekMovie(CurrentMovie, Emulator, 0) == 0) {
+        CurrentMovieMode = MOVIE_MODE_PLAY;
+        MovieFrame = 0;
+        MovieDesyncs = 0;
+    }
+}
+
+static void SeekPlayback(int32_t frames) {
+    if (CurrentMovieMode != MOVIE_MODE_PLAY) {
+        return;
+    }
+
+    int64_t target = (int64_t)MovieFrame + frames;
+    int64_t frameCount = GetMovieFrameCount(CurrentMovie);
+    target = target < 0 ? 0 : target > frameCount ? frameCount : target;
+
+    if (target != MovieFrame && SeekMovie(CurrentMovie, Emulator, (uint32_t)target) == 0) {
+        SeekScheduler(&Clock, (uint32_t)target);
+        MovieFrame = (uint32_t)target;
+    }
+}
+
+static void SetSpeed(int32_t instructionsPerSecond) {
+    // The movie's frame boundaries depend on the speed it was recorded at.
+    if (CurrentMovieMode != MOVIE_MODE_OFF) {
+        return;
+    }
+
+    uint32_t ips = instructionsPerSecond < SCHEDULER_MIN_IPS ? SCHEDULER_MIN_IPS
+                   : instructionsPerSecond > SCHEDULER_MAX_IPS
+                       ? SCHEDULER_MAX_IPS
+                       : (uint32_t)instructionsPerSecond;
+
+    if (ips != Clock.instructionsPerSecond) {
+        ResetScheduler(&Clock, ips, NowSeconds());
+    }
+}
+
+// Keys for the frame about to run: the keypad, or the movie being played back.
+static void BeginFrame(uint32_t frame) {
+    uint16_t keys;
+
+    if (CurrentMovieMode == MOVIE_MODE_PLAY) {
+        if (!ApplyMovieKeyframe(CurrentMovie, Emulator, frame)) {
+            MovieDesyncs++;
+        }
+
+        keys = GetMovieKeys(CurrentMovie, frame);
+        MovieFrame = frame + 1;
+    } else {
+        keys = ReadKeypad();
+
+        if (CurrentMovieMode == MOVIE_MODE_RECORD) {
+            RecordMovieFrame(CurrentMovie, Emulator, keys);
+        }
+    }
+
+    CHIP8_SetKeys(Emulator, keys);
+}
+
+static void RecordRewindFrame() {
+    CHIP8_STATE state;
+    CHIP8_SaveState(Emulator, &state);
+    PushRewindFrame(Rewind, &state);
+}
+
+static void EndFrame(uint32_t frame) {
+    RecordRewindFrame();
+    HasNewFrame = true;
+
+    if (CurrentMovieMode == MOVIE_MODE_PLAY && frame + 1 >= GetMovieFrameCount(CurrentMovie)) {
+        StopMovie();
+    }
+}
+
+static void RewindFrame() {
+    CHIP8_STATE state;
+
+    if (!StepRewindBack(Rewind, &state)) {
+        return;
+    }
+
+    CHIP8_LoadState(Emulator, &state);
+    HasNewFrame = true;
+
+    // The newest saved frame was the last one completed; the state is now the end of the one
+    // before it, and whatever of the current frame had run is gone too.
+    uint32_t completed = GetCompletedFrames(&Clock);
+    SeekScheduler(&Clock, completed > 0 ? completed - 1 : 0);
+
+    // Rewinding a recording takes back the frames it steps over.
+    if (CurrentMovieMode == MOVIE_MODE_RECORD) {
+        TruncateMovie(CurrentMovie, Clock.frame);
+    }
+}
+
+// A loaded quick save becomes the end of the current frame, even if that frame was only partly
+// run, so there stays one rewind entry and one movie frame per scheduler frame.
+static void FinishQuickLoad() {
+    bool atFrameEnd = GetCompletedFrames(&Clock) == Clock.frame;
+
+    if (atFrameEnd) {
+        DropNewestRewindFrame(Rewind);
+    }
+
+    SeekScheduler(&Clock, Clock.frame);
+
+    // Before the first frame there is no frame end to stand in for.
+    if (Clock.frame > 0) {
+        RecordRewindFrame();
+    }
+
+    if (CurrentMovieMode == MOVIE_MODE_RECORD) {
+        RecordMovieJump(CurrentMovie, Emulator);
+    }
+}
+
+static void RunCommand(const EmulationCommand* command) {
+    // Playback owns the machine state; quick loads would fight it.
+    bool isPlaying = CurrentMovieMode == MOVIE_MODE_PLAY;
+
+    switch (command->type) {
+        case EMULATION_COMMAND_LOAD_ROM:
+            StopMovie();
+            LoadRom(command->romPath);
+            break;
+        case EMULATION_COMMAND_QUICK_SAVE:
+            if (!isPlaying) {
+                CHIP8_SaveState(Emulator, &QuickSave);
+                HasQuickSave = true;
+            }
+            break;
+        case EMULATION_COMMAND_QUICK_LOAD:
+            if (!isPlaying && HasQuickSave && CHIP8_LoadState(Emulator, &QuickSave) == 0) {
+                FinishQuickLoad();
+            }
+            break;
+        case EMULATION_COMMAND_TOGGLE_RECORDING:
+            if (CurrentMovieMode == MOVIE_MODE_OFF) {
+                StartRecording();
+            } else {
+                StopMovie();
+            }
+            break;
+        case EMULATION_COMMAND_TOGGLE_PLAYBACK:
+            if (CurrentMovieMode == MOVIE_MODE_OFF) {
+                StartPlayback();
+            } else {
+                StopMovie();
+            }
+            break;
+        case EMULATION_COMMAND_SEEK:
+            SeekPlayback(command->value);
+            break;
+        case EMULATION_COMMAND_SET_IPS:
+            SetSpeed(command->value);
+            break;
+        case EMULATION_COMMAND_SET_RUN_AHEAD:
+            RunAheadFrames = command->value < 0 ? 0
+                             : command->value > EMULATION_MAX_RUN_AHEAD_FRAMES
+                                 ? EMULATION_MAX_RUN_AHEAD_FRAMES
+                                 : command->value;
+            break;
+        case EMULATION_COMMAND_STEP:
+            if (CurrentRunMode == RUN_MODE_STEP) {
+                CHIP8_SimulateCycle(Emulator);
+            }
+            break;
+    }
+
+    HasNewFrame = true;
+}
+
+static void RunCommands() {
+    uint32_t tail = AtomicLoad(&CommandTail);
+
+    while (tail != AtomicLoad(&CommandHead)) {
+        RunCommand(&Commands[tail % COMMAND_QUEUE_SIZE]);
+        AtomicStore(&CommandTail, ++tail);
+    }
+}
+
+static void RunRewind(double elapsed) {
+    RewindOwedFrames += elapsed * SCHEDULER_TIMER_HZ;
+
+    for (; RewindOwedFrames >= 1.0; RewindOwedFrames -= 1.0) {
+        RewindFrame();
+    }
+}
+
+static void RunTurbo() {
+    double start = NowSeconds();
+    double now = start;
+    uint32_t startFrames = GetCompletedFrames(&Clock);
+    uint64_t frameInstructions = Clock.instructionsPerSecond / SCHEDULER_TIMER_HZ;
+
+    if (TurboWindowFrames == 0) {
+        TurboWindowStart = start;
+    }
+
+    do {
+        RunScheduled(&Clock, Emulator, frameInstructions);
+        now = NowSeconds();
+    } while (now - start < TURBO_SLICE);
+
+    TurboWindowFrames += GetCompletedFrames(&Clock) - startFrames;
+    SyncSchedulerClock(&Clock, now);
+
+    // Emulated seconds over wall seconds.
+    if (now - TurboWindowStart >= TURBO_REPORT_INTERVAL) {
+        TurboSpeed = TurboWindowFrames / ((now - TurboWindowStart) * SCHEDULER_TIMER_HZ);
+        TurboWindowStart = now;
+        TurboWindowFrames = 0;
+    }
+}
+
+// Speculative frames take the keys the real frame would get, without recording anything.
+static void RunAheadBeginFrame(uint32_t frame) {
+    bool isPlaying = CurrentMovieMode == MOVIE_MODE_PLAY;
+    CHIP8_SetKeys(Emulator, isPlaying ? GetMovieKeys(CurrentMovie, frame) : ReadKeypad());
+}
+
+static void RunAheadEndFrame(uint32_t frame) {
+    (void)frame;
+}
+
+// Copies the screen RunAheadFrames frames from now into `published`, assuming the keys stay as
+// they are, then puts the real state back.
+static void RunAhead(EmulationFrame* published) {
+    double start = NowSeconds();
+
+    CHIP8_STATE real;
+    CHIP8_SaveState(Emulator, &real);
+
+    Scheduler ahead = Clock;
+    ahead.beginFrame = RunAheadBeginFrame;
+    ahead.endFrame = RunAheadEndFrame;
+
+    uint32_t target = GetCompletedFrames(&Clock) + (uint32_t)RunAheadFrames;
+    RunScheduled(&ahead, Emulator,
+                 GetFrameStartInstruction(ahead.instructionsPerSecond, target) - ahead.executed);
+
+    const CHIP_8GFX* gfx = CHIP8_GetGFXView(Emulator);
+
+    // Versions only go up on one instance, so AheadVersion can't have been given to another screen.
+    if (AheadVersion == 0 || memcmp(gfx, &AheadGfx, sizeof(AheadGfx)) != 0) {
+        AheadGfx = *gfx;
+        AheadVersion = CHIP8_GetFramebufferVersion(Emulator);
+    }
+
+    published->gfx = AheadGfx;
+    published->version = AheadVersion;
+    CHIP8_LoadState(Emulator, &real);
+
+    // Smoothed so the readout holds still.
+    RunAheadCost += (NowSeconds() - start - RunAheadCost) * 0.1;
+}
+
+static void PublishFrame() {
+    EmulationFrame* frame = &Frames[BackFrame];
+
+    frame->soundTimer = CHIP8_GetSoundTimer(Emulator);
+
+    // Rewinding, turbo and stepping show the real state.
+    if (RunAheadFrames > 0 && !IsRewinding && !IsTurbo && CurrentRunMode == RUN_MODE_NORMAL) {
+        RunAhead(frame);
+    } else {
+        frame->gfx = *CHIP8_GetGFXView(Emulator);
+        frame->version = CHIP8_GetFramebufferVersion(Emulator);
+    }
+
+    frame->instructionsPerSecond = Clock.instructionsPerSecond;
+    frame->isRewinding = IsRewinding;
+    frame->isTurbo = IsTurbo;
+    frame->turboSpeed = TurboSpeed;
+    frame->runAheadCost = RunAheadCost;
+    frame->movieMode = CurrentMovieMode;
+    frame->movieFrame = MovieFrame;
+    frame->movieFrameCount = GetMovieFrameCount(CurrentMovie);
+    frame->movieDesyncs = MovieDesyncs;
+
+    BackFrame = AtomicExchange(&MiddleFrame, BackFrame | FRESH_FRAME) & ~FRESH_FRAME;
+    HasNewFrame = false;
+}
+
+// Wall time until the frame in progress ends, which is when there is next something to publish.
+static double SecondsToFrameEnd() {
+    if (IsRewinding || CurrentRunMode == RUN_MODE_STEP) {
+        return 1.0 / SCHEDULER_TIMER_HZ;
+    }
+
+    uint32_t ips = Clock.instructionsPerSecond;
+    uint64_t frameEnd = GetFrameStartInstruction(ips, GetCompletedFrames(&Clock) + 1);
+    double owed = (double)(frameEnd - Clock.executed) - Clock.owedInstructions;
+
+    return owed > 0.0 ? owed / ips : 0.0;
+}
+
+static void RunEmulation() {
+    double last = NowSeconds();
+    SyncSchedulerClock(&Clock, last);
+
+    while (AtomicLoad(&Running)) {
+        RunCommands();
+
+        uint32_t controls = AtomicLoad(&Controls);
+        double now = NowSeconds();
+
+        // Playback owns the machine state; rewinding would fight it.
+        bool wasRewinding = IsRewinding;
+        bool wasTurbo = IsTurbo;
+        IsRewinding = CurrentMovieMode != MOVIE_MODE_PLAY && (controls & EMULATION_REWIND);
+        IsTurbo = !IsRewinding && (controls & EMULATION_TURBO);
+        HasNewFrame |= IsRewinding != wasRewinding || IsTurbo != wasTurbo;
+
+        if (!IsRewinding) {
+            RewindOwedFrames = 0.0;
+        }
+
+        if (!IsTurbo) {
+            TurboWindowFrames = 0;
+        }
+
+        if (IsRewinding) {
+            RunRewind(now - last);
+            SyncSchedulerClock(&Clock, now);
+        } else if (CurrentRunMode == RUN_MODE_STEP) {
+            SyncSchedulerClock(&Clock, now);
+        } else if (IsTurbo) {
+            RunTurbo();
+        } else {
+            RunScheduled(&Clock, Emulator, AdvanceSchedulerClock(&Clock, now));
+        }
+
+        last = now;
+
+        if (HasNewFrame) {
+            PublishFrame();
+        }
+
+        // Turbo goes straight on; otherwise wake up as the next frame finishes.
+        if (!IsTurbo) {
+            SleepSeconds(SecondsToFrameEnd());
+        }
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI EmulationThread(LPVOID argument) {
+    (void)argument;
+    RunEmulation();
+    return 0;
+}
+#else
+static void* EmulationThread(void* argument) {
+    (void)argument;
+    RunEmulation();
+    return NULL;
+}
+#endif
+
+static void DestroyEmulation() {
+    DestroyMovie(CurrentMovie);
+    DestroyRewindBuffer(Rewind);
+    CHIP8_Destroy(Emulator);
+
+    CurrentMovie = NULL;
+    Rewind = NULL;
+    Emulator = NULL;
+}
+
+int StartEmulation(const char* romPath, uint32_t instructionsPerSecond) {
+    Emulator = CHIP8_Create();
+    // A new instance numbers its frames from the start again.
+    AheadVersion = 0;
+    Rewind = CreateRewindBuffer(REWIND_BUFFER_BYTES);
+    CurrentMovie = CreateMovie();
+
+    if (Emulator == NULL || Rewind == NULL || CurrentMovie == NULL) {
+        DestroyEmulation();
+        return -1;
+    }
+
+    CHIP8_SetRandomSeed(Emulator, (uint32_t)time(NULL));
+
+    if (LoadRom(romPath) != 0) {
+        DestroyEmulation();
+        return -1;
+    }
+
+    Clock.beginFrame = BeginFrame;
+    Clock.endFrame = EndFrame;
+    ResetScheduler(&Clock, instructionsPerSecond, NowSeconds());
+
+    // So the render thread has a frame before the first one is finished.
+    PublishFrame();
+
+    AtomicStore(&Running, 1);
+
+#if defined(_WIN32)
+    Thread = CreateThread(NULL, 0, EmulationThread, NULL, 0, NULL);
+    bool started = Thread != NULL;
+#else
+    bool started = pthread_create(&Thread, NULL, EmulationThread, NULL) == 0;
+#endif
+
+    if (!started) {
+        DestroyEmulation();
+        return -1;
+    }
+
+    return 0;
+}
+
+void StopEmulation() {
+    AtomicStore(&Running, 0);
+
+#if defined(_WIN32)
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+#else
+    pthread_join(Thread, NULL);
+#endif
+
+    StopMovie();
+    DestroyEmulation();
+}
+
+void SetEmulationControls(uint32_t controls) { AtomicStore(&Controls, controls); }
+
+bool SendEmulationCommand(const EmulationCommand* command) {
+    // Only this thread moves the head, so it can't change under us.
+    uint32_t head = AtomicLoad(&CommandHead);
+
+    if (head - AtomicLoad(&CommandTail) == COMMAND_QUEUE_SIZE) {
+        return false;
+    }
+
+    Commands[head % COMMAND_QUEUE_SIZE] = *command;
+    AtomicStore(&CommandHead, head + 1);
+    return true;
+}
+
+const EmulationFrame* AcquireEmulationFrame() {
+    if (AtomicLoad(&MiddleFrame) & FRESH_FRAME) {
+        FrontFrame = AtomicExchange(&MiddleFrame, FrontFrame) & ~FRESH_FRAME;
+    }
+
+    return &Frames[FrontFrame];
+}
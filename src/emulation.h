@@ -0,0 +1,84 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// The core runs on its own thread, on its own monotonic clock, so a vsync wait or a slow frame on
+// the render thread doesn't hold it up. Everything that touches the machine (the scheduler, rewind,
+// movies, quick saves, run-ahead) lives on that thread. The render thread talks to it three ways:
+//
+// - SetEmulationControls stores the held keypad keys and modifiers in one atomic word, read at
+//   the start of every emulated frame.
+// - SendEmulationCommand queues one-off requests (hotkeys, ROM picks) in a lock-free ring.
+// - AcquireEmulationFrame swaps in the newest finished frame from a lock-free triple buffer.
+//
+// None of these block, and there is only one emulation at a time.
+
+#define EMULATION_MAX_ROM_PATH 512
+#define EMULATION_MAX_RUN_AHEAD_FRAMES 4
+// Controls word: bits 0-15 are the keypad, bit i for key i, then the held modifiers.
+#define EMULATION_KEYS 0xFFFFu
+#define EMULATION_REWIND (1u << 16)
+#define EMULATION_TURBO (1u << 17)
+
+typedef enum {
+    MOVIE_MODE_OFF,
+    MOVIE_MODE_RECORD,
+    MOVIE_MODE_PLAY,
+} MOVIE_MODE;
+
+typedef enum {
+    // Stops any movie and loads `romPath`.
+    EMULATION_COMMAND_LOAD_ROM,
+    EMULATION_COMMAND_QUICK_SAVE,
+    EMULATION_COMMAND_QUICK_LOAD,
+    // Start recording or playing back the movie file, or stop whichever movie is running.
+    EMULATION_COMMAND_TOGGLE_RECORDING,
+    EMULATION_COMMAND_TOGGLE_PLAYBACK,
+    // Moves playback by `value` frames, negative for backwards.
+    EMULATION_COMMAND_SEEK,
+    // Instructions per second; ignored while a movie is running.
+    EMULATION_COMMAND_SET_IPS,
+    EMULATION_COMMAND_SET_RUN_AHEAD,
+    // Runs one instruction when in step mode.
+    EMULATION_COMMAND_STEP,
+} EMULATION_COMMAND;
+
+typedef struct EmulationCommand {
+    EMULATION_COMMAND type;
+    int32_t value;
+    char romPath[EMULATION_MAX_ROM_PATH];
+} EmulationCommand;
+
+// A finished frame and what the overlays need to describe it, copied out as one unit so the
+// render thread never sees a screen from one frame with the status of another.
+typedef struct EmulationFrame {
+    CHIP_8GFX gfx;
+    // CHIP8_GetFramebufferVersion of `gfx`; equal versions are identical screens.
+    uint64_t version;
+    uint8_t soundTimer;
+
+    uint32_t instructionsPerSecond;
+    bool isRewinding;
+    bool isTurbo;
+    double turboSpeed;
+    double runAheadCost;
+
+    MOVIE_MODE movieMode;
+    uint32_t movieFrame;
+    uint32_t movieFrameCount;
+    uint32_t movieDesyncs;
+} EmulationFrame;
+
+// Loads `romPath` and starts the thread. Returns -1 if the ROM or the thread couldn't be set up.
+int StartEmulation(const char* romPath, uint32_t instructionsPerSecond);
+// Stops the thread, saving a movie that is being recorded.
+void StopEmulation();
+
+void SetEmulationControls(uint32_t controls);
+// Returns false if the queue is full and the command was dropped.
+bool SendEmulationCommand(const EmulationCommand* command);
+// The newest finished frame. Stays valid and unchanged until the next call; only the render
+// thread may call it.
+const EmulationFrame* AcquireEmulationFrame();
@@ -0,0 +1,266 @@
+#include "filter.h"
+#include <string.h>
+
+#define TOP_BIT (1ull << 63)
+// xBR looks two pixels out; the Scale filters only one.
+#define WINDOW_RADIUS 2
+#define WINDOW_SIZE (2 * WINDOW_RADIUS + 1)
+
+// The neighborhood of one screen row: at each pixel's bit, words[dy][dx] holds the pixel dx to the
+// right of it and dy below it (offset by WINDOW_RADIUS). Off-screen pixels repeat the edge.
+typedef struct Window {
+    uint64_t words[WINDOW_SIZE][WINDOW_SIZE];
+} Window;
+
+static const char* FilterNames[SCREEN_FILTER_COUNT] = {
+    [SCREEN_FILTER_NONE] = "none",
+    [SCREEN_FILTER_SCALE2X] = "scale2x",
+    [SCREEN_FILTER_SCALE3X] = "scale3x",
+    [SCREEN_FILTER_XBR_LITE] = "xbr-lite",
+};
+
+static const int FilterScales[SCREEN_FILTER_COUNT] = {
+    [SCREEN_FILTER_NONE] = 1,
+    [SCREEN_FILTER_SCALE2X] = 2,
+    [SCREEN_FILTER_SCALE3X] = 3,
+    [SCREEN_FILTER_XBR_LITE] = 2,
+};
+
+static uint64_t ShiftX(uint64_t row, int dx) {
+    for (; dx > 0; dx--) {
+        row = (row << 1) | (row & 1);
+    }
+
+    for (; dx < 0; dx++) {
+        row = (row >> 1) | (row & TOP_BIT);
+    }
+
+    return row;
+}
+
+static void LoadWindow(const CHIP_8GFX* gfx, int y, Window* window) {
+    for (int dy = -WINDOW_RADIUS; dy <= WINDOW_RADIUS; dy++) {
+        int sourceY = y + dy < 0 ? 0 : y + dy;
+        sourceY = sourceY < CHIP8_SCREEN_HEIGHT ? sourceY : CHIP8_SCREEN_HEIGHT - 1;
+
+        for (int dx = -WINDOW_RADIUS; dx <= WINDOW_RADIUS; dx++) {
+            window->words[dy + WINDOW_RADIUS][dx + WINDOW_RADIUS] = ShiftX(gfx->rows[sourceY], dx);
+        }
+    }
+}
+
+static uint64_t At(const Window* window, int dx, int dy) {
+    return window->words[dy + WINDOW_RADIUS][dx + WINDOW_RADIUS];
+}
+
+// Per pixel: `when` ? `then` : `otherwise`.
+static uint64_t Select(uint64_t when, uint64_t then, uint64_t otherwise) {
+    return (when & then) | (~when & otherwise);
+}
+
+// Scale2x's condition for the corner towards (sx, sy): the two neighbors on that side match each
+// other and neither matches the neighbor opposite it. The corner then takes the side neighbor.
+static uint64_t Scale2xCondition(const Window* window, int sx, int sy) {
+    uint64_t b = At(window, 0, -sy);
+    uint64_t d = At(window, -sx, 0);
+    uint64_t f = At(window, sx, 0);
+    uint64_t h = At(window, 0, sy);
+
+    return ~(h ^ f) & (d ^ h) & (b ^ f);
+}
+
+static uint64_t Scale2xCorner(const Window* window, int sx, int sy) {
+    return Select(Scale2xCondition(window, sx, sy), At(window, sx, 0), At(window, 0, 0));
+}
+
+// Scale3x's middle of the left or right edge (sy == 0) or of the top or bottom edge (sx == 0).
+static uint64_t Scale3xEdge(const Window* window, int sx, int sy) {
+    uint64_t e = At(window, 0, 0);
+    uint64_t first;
+    uint64_t second;
+
+    if (sy == 0) {
+        first = Scale2xCondition(window, sx, -1) & (e ^ At(window, sx, 1));
+        second = Scale2xCondition(window, sx, 1) & (e ^ At(window, sx, -1));
+    } else {
+        first = Scale2xCondition(window, -1, sy) & (e ^ At(window, 1, sy));
+        second = Scale2xCondition(window, 1, sy) & (e ^ At(window, -1, sy));
+    }
+
+    return Select(first | second, At(window, sx, sy), e);
+}
+
+// Bit planes of a + b + c + d, each lane 0 to 4. Three full adders; at most two of the carries
+// can be set, so their parity and majority are the upper two bits.
+static void Sum4(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t sum[4]) {
+    uint64_t s1 = a ^ b;
+    uint64_t c1 = a & b;
+    uint64_t s2 = s1 ^ c;
+    uint64_t c2 = s1 & c;
+    uint64_t c3 = s2 & d;
+
+    sum[0] = s2 ^ d;
+    sum[1] = c1 ^ c2 ^ c3;
+    sum[2] = (c1 & c2) | (c1 & c3) | (c2 & c3);
+    sum[3] = 0;
+}
+
+// Per lane a < b, for 4-bit numbers given as bit planes.
+static uint64_t LessThan(const uint64_t a[4], const uint64_t b[4]) {
+    uint64_t less = 0;
+    uint64_t equal = ~0ull;
+
+    for (int bit = 3; bit >= 0; bit--) {
+        less |= equal & ~a[bit] & b[bit];
+        equal &= ~(a[bit] ^ b[bit]);
+    }
+
+    return less;
+}
+
+// 2xBR for the corner towards (sx, sy), with xBR's names for the window as seen from that
+// corner. The corner flips to the other color when F and H both differ from E and the edge along
+// F-H is weaker than the one along E-I. Its 4 * d(H, F) term is always 0 once F and H agree.
+static uint64_t XbrCorner(const Window* window, int sx, int sy) {
+    uint64_t e = At(window, 0, 0);
+    uint64_t b = At(window, 0, -sy);
+    uint64_t c = At(window, sx, -sy);
+    uint64_t d = At(window, -sx, 0);
+    uint64_t f = At(window, sx, 0);
+    uint64_t f4 = At(window, 2 * sx, 0);
+    uint64_t g = At(window, -sx, sy);
+    uint64_t h = At(window, 0, sy);
+    uint64_t i = At(window, sx, sy);
+    uint64_t i4 = At(window, 2 * sx, sy);
+    uint64_t h5 = At(window, 0, 2 * sy);
+    uint64_t i5 = At(window, sx, 2 * sy);
+
+    uint64_t weight1[4];
+    uint64_t weight2[4];
+    Sum4(e ^ c, e ^ g, i ^ h5, i ^ f4, weight1);
+    Sum4(h ^ d, h ^ i5, f ^ i4, f ^ b, weight2);
+
+    // Plus 4 * d(E, I).
+    uint64_t ei = e ^ i;
+    weight2[3] = weight2[2] & ei;
+    weight2[2] ^= ei;
+
+    return e ^ ((e ^ f) & (e ^ h) & LessThan(weight1, weight2));
+}
+
+// Spreads the 8 bits of `byte` `scale` bits apart: bit k moves to bit k * scale.
+static uint64_t Spread(uint64_t byte, int scale) {
+    switch (scale) {
+        case 2:
+            byte = (byte | byte << 4) & 0x0F0F;
+            byte = (byte | byte << 2) & 0x3333;
+            return (byte | byte << 1) & 0x5555;
+        case 3:
+            byte = (byte | byte << 8) & 0x00F00F;
+            byte = (byte | byte << 4) & 0x0C30C3;
+            return (byte | byte << 2) & 0x249249;
+        default:
+            return byte;
+    }
+}
+
+// One output row from the `scale` sub-pixel columns of a screen row: output pixel x * scale + i
+// is pixel x of cells[i].
+static void Interleave(const uint64_t* cells, int scale, uint64_t* out) {
+    int used = 0;
+
+    memset(out, 0, sizeof(uint64_t) * scale);
+
+    for (int byte = 0; byte < 8; byte++) {
+        int count = 8 * scale;
+        uint64_t bits = 0;
+
+        for (int i = 0; i < scale; i++) {
+            bits |= Spread((cells[i] >> (56 - 8 * byte)) & 0xFF, scale) << (scale - 1 - i);
+        }
+
+        int word = used / 64;
+        int free = 64 - used % 64;
+
+        if (count <= free) {
+            out[word] |= bits << (free - count);
+        } else {
+            out[word] |= bits >> (count - free);
+            out[word + 1] |= bits << (64 - (count - free));
+        }
+
+        used += count;
+    }
+}
+
+const char* GetScreenFilterName(SCREEN_FILTER filter) {
+    return (unsigned)filter < SCREEN_FILTER_COUNT ? FilterNames[filter] : FilterNames[0];
+}
+
+int GetScreenFilterScale(SCREEN_FILTER filter) {
+    return (unsigned)filter < SCREEN_FILTER_COUNT ? FilterScales[filter] : 1;
+}
+
+void ApplyScreenFilter(SCREEN_FILTER filter, const CHIP_8GFX* gfx, PackedImage* image) {
+    int scale = GetScreenFilterScale(filter);
+
+    image->width = CHIP8_SCREEN_WIDTH * scale;
+    image->height = CHIP8_SCREEN_HEIGHT * scale;
+
+    if (scale == 1) {
+        for (int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+            image->rows[y][0] = gfx->rows[y];
+        }
+
+        return;
+    }
+
+    Window window;
+    uint64_t cells[FILTER_MAX_SCALE][FILTER_MAX_SCALE];
+
+    for (int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        LoadWindow(gfx, y, &window);
+
+        switch (filter) {
+            case SCREEN_FILTER_SCALE3X:
+                cells[0][0] = Scale2xCorner(&window, -1, -1);
+                cells[0][1] = Scale3xEdge(&window, 0, -1);
+                cells[0][2] = Scale2xCorner(&window, 1, -1);
+                cells[1][0] = Scale3xEdge(&window, -1, 0);
+                cells[1][1] = At(&window, 0, 0);
+                cells[1][2] = Scale3xEdge(&window, 1, 0);
+                cells[2][0] = Scale2xCorner(&window, -1, 1);
+                cells[2][1] = Scale3xEdge(&window, 0, 1);
+                cells[2][2] = Scale2xCorner(&window, 1, 1);
+                break;
+            case SCREEN_FILTER_XBR_LITE:
+                cells[0][0] = XbrCorner(&window, -1, -1);
+                cells[0][1] = XbrCorner(&window, 1, -1);
+                cells[1][0] = XbrCorner(&window, -1, 1);
+                cells[1][1] = XbrCorner(&window, 1, 1);
+                break;
+            default:
+                cells[0][0] = Scale2xCorner(&window, -1, -1);
+                cells[0][1] = Scale2xCorner(&window, 1, -1);
+                cells[1][0] = Scale2xCorner(&window, -1, 1);
+                cells[1][1] = Scale2xCorner(&window, 1, 1);
+                break;
+        }
+
+        for (int j = 0; j < scale; j++) {
+            Interleave(cells[j], scale, image->rows[y * scale + j]);
+        }
+    }
+}
+
+const PackedImage* FilterScreen(FilterCache* cache, SCREEN_FILTER filter, const CHIP_8GFX* gfx,
+                                uint64_t version) {
+    if (!cache->valid || cache->filter != filter || cache->version != version) {
+        ApplyScreenFilter(filter, gfx, &cache->image);
+        cache->valid = true;
+        cache->filter = filter;
+        cache->version = version;
+    }
+
+    return &cache->image;
+}
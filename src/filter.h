@@ -0,0 +1,48 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Largest output is Scale3x's, three times the screen each way.
+#define FILTER_MAX_SCALE 3
+#define FILTER_MAX_WIDTH (CHIP8_SCREEN_WIDTH * FILTER_MAX_SCALE)
+#define FILTER_MAX_HEIGHT (CHIP8_SCREEN_HEIGHT * FILTER_MAX_SCALE)
+#define FILTER_MAX_WORDS (FILTER_MAX_WIDTH / 64)
+
+// Edge-aware pixel-art upscalers. The screen is 1-bit, so every rule is a handful of AND/OR/XOR on
+// whole packed rows: 64 pixels per operation, with no per-pixel branches.
+typedef enum {
+    SCREEN_FILTER_NONE,
+    SCREEN_FILTER_SCALE2X,
+    SCREEN_FILTER_SCALE3X,
+    // The 2xBR corner rule (edge weights over a 5x5 window), snapped to 1-bit output.
+    SCREEN_FILTER_XBR_LITE,
+    SCREEN_FILTER_COUNT,
+} SCREEN_FILTER;
+
+// A 1-bit image laid out like CHIP_8GFX: row y is `width` bits starting at rows[y][0], the
+// leftmost pixel in the most significant bit.
+typedef struct PackedImage {
+    int width;
+    int height;
+    uint64_t rows[FILTER_MAX_HEIGHT][FILTER_MAX_WORDS];
+} PackedImage;
+
+// The last filtered frame, so an unchanged frame costs one comparison.
+typedef struct FilterCache {
+    bool valid;
+    SCREEN_FILTER filter;
+    uint64_t version;
+    PackedImage image;
+} FilterCache;
+
+const char* GetScreenFilterName(SCREEN_FILTER filter);
+// How many times wider and taller than the screen the filter's output is.
+int GetScreenFilterScale(SCREEN_FILTER filter);
+
+void ApplyScreenFilter(SCREEN_FILTER filter, const CHIP_8GFX* gfx, PackedImage* image);
+// `gfx` through `filter`, only recomputed when `version` (CHIP8_GetFramebufferVersion, or a
+// Compositor's version for its layers) or the filter differs from the previous call.
+const PackedImage* FilterScreen(FilterCache* cache, SCREEN_FILTER filter, const CHIP_8GFX* gfx,
+                                uint64_t version);
@@ -1,8 +1,14 @@
-#include "chip8.h"
+#include "compositor.h"
+#include "emulation.h"
+#include "filter.h"
 #include "resource_dir.h"
+#include "scheduler.h"
+#include "upscale.h"
 #include <raylib.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define RAYGUI_IMPLEMENTATION
 #include "raygui.h"
@@ -16,34 +22,99 @@
 
 #define SCALE 10
 #define FPS 60
-#define CYCLE_MULTIPLIER (FPS / 6) // 30 * 60 =
-
-typedef enum {
-    RUN_MODE_NORMAL,
-    RUN_MODE_STEP,
-} RUN_MODE;
+// Instructions per second unless --ips says otherwise; - and = halve and double it.
+#define DEFAULT_IPS 600
+#define MOVIE_SEEK_FRAMES (5 * SCHEDULER_TIMER_HZ)
+#define DEFAULT_MAX_FRAME_SKIP 2
+#define MAX_FRAME_SKIP 8
+// A display frame is late when it took this many frame periods or more.
+#define LATE_FRAME_PERIODS 1.2
+#define UPSCALED_WIDTH (CHIP8_SCREEN_WIDTH * SCALE)
+#define UPSCALED_HEIGHT (CHIP8_SCREEN_HEIGHT * SCALE)
+#define MAX_PICKED_COMPOSITE_MODES 16
 
 typedef struct ButtonStates {
     bool loadFilePressed;
     bool romPickerOpen;
     char* selectedFilePath;
+    bool runAheadEditMode;
+    bool frameSkipEditMode;
 } ButtonStates;
 
-RUN_MODE CurrentRunMode = RUN_MODE_NORMAL;
-
-void StepCycle() {
-    switch (CurrentRunMode) {
-        case RUN_MODE_NORMAL:
-            CHIP8_SimulateCycle();
-            break;
-        case RUN_MODE_STEP:
-            bool HasPressedStepKey = IsKeyPressed(KEY_K);
-            if (HasPressedStepKey)
-                CHIP8_SimulateCycle();
-    }
-}
-
-void HandleInput() {
+typedef struct PickedCompositeMode {
+    char romPath[EMULATION_MAX_ROM_PATH];
+    COMPOSITE_MODE mode;
+} PickedCompositeMode;
+
+const char* DefaultRomPath = "roms/tests/1-chip8-logo.ch8";
+
+// Held tab, or --turbo on the command line, runs the emulation as fast as it goes.
+bool TurboFromCommandLine = false;
+
+// Frames shown ahead of the real state, set from the spinner at the bottom.
+int RunAheadFrames = 0;
+int SentRunAheadFrames = 0;
+
+// Every emulated frame goes into ScreenCompositor, which hides XOR flicker in the mode picked for
+// the current ROM: GetDefaultCompositeMode until the dropdown changes it, after which the choice
+// is remembered for that ROM until the program exits.
+Compositor ScreenCompositor = {0};
+// The flicker dropdown's selection, in COMPOSITE_MODE order.
+int SelectedCompositeMode = COMPOSITE_MODE_OFF;
+char CurrentRomPath[EMULATION_MAX_ROM_PATH];
+PickedCompositeMode PickedCompositeModes[MAX_PICKED_COMPOSITE_MODES];
+int NextPickedCompositeMode = 0;
+
+// The compositor's layers go through CurrentFilter (cached by compositor version), then into a
+// one-byte-per-pixel texture at the filter's resolution, drawn SCALE times the CHIP-8's resolution
+// with point filtering. The texture is only uploaded again when the compositor's version or the
+// filter changes, and is always drawn at the size it was last uploaded at.
+//
+// After a late frame, up to MaxFrameSkip frames in a row are skipped; emulation keeps to its own
+// clock either way. The software renderer keeps its framebuffer between frames, so there a
+// skipped frame draws nothing at all (no texture upload, screen quad, overlays or UI) and
+// EndDrawing presents the previous picture again. Hardware GL leaves the back buffer undefined
+// after a swap, so there a skipped frame still draws everything and only saves the upload. A frame
+// that changes the filter is never skipped.
+SCREEN_FILTER CurrentFilter = SCREEN_FILTER_NONE;
+// The filter dropdown's selection, in SCREEN_FILTER order.
+int SelectedFilter = SCREEN_FILTER_NONE;
+FilterCache ScreenFilters[COMPOSITOR_FRAMES] = {0};
+Texture2D ScreenTexture;
+uint8_t ScreenPixels[FILTER_MAX_HEIGHT * FILTER_MAX_WIDTH];
+// The compositor's version is above 0 from the first frame pushed.
+uint64_t ScreenVersion = 0;
+SCREEN_FILTER ScreenVersionFilter = SCREEN_FILTER_NONE;
+int ScreenWidth = CHIP8_SCREEN_WIDTH;
+int ScreenHeight = CHIP8_SCREEN_HEIGHT;
+#if defined(GRAPHICS_API_OPENGL_11_SOFTWARE)
+bool SkipKeepsPicture = true;
+#else
+bool SkipKeepsPicture = false;
+#endif
+int MaxFrameSkip = DEFAULT_MAX_FRAME_SKIP;
+int ConsecutiveSkips = 0;
+uint32_t SkippedFrames = 0;
+uint32_t LateFrames = 0;
+
+// With --cpu-upscale, or by default when raylib renders in software, the texture is instead the
+// full-size RGBA image from UpscaleImage, blitted 1:1, so the GL side does no scaling. F12 saves
+// the same image as a screenshot and F11 starts and stops appending it to a raw RGBA capture.
+#if defined(GRAPHICS_API_OPENGL_11_SOFTWARE)
+bool CpuUpscale = true;
+#else
+bool CpuUpscale = false;
+#endif
+uint32_t UpscaledPixels[UPSCALED_HEIGHT * UPSCALED_WIDTH];
+int UpscaledWidth = 0;
+int UpscaledHeight = 0;
+uint64_t UpscaledVersion = 0;
+SCREEN_FILTER UpscaledFilter = SCREEN_FILTER_NONE;
+FILE* Capture = NULL;
+int CaptureWidth = 0;
+int CaptureHeight = 0;
+
+uint16_t ReadKeypad() {
     bool pressedKeys[CHIP8_INPUTS] = {IsKeyDown(KEY_X),     IsKeyDown(KEY_ONE), IsKeyDown(KEY_TWO),
                                       IsKeyDown(KEY_THREE), IsKeyDown(KEY_Q),   IsKeyDown(KEY_W),
                                       IsKeyDown(KEY_E),     IsKeyDown(KEY_A),   IsKeyDown(KEY_S),
@@ -53,33 +124,348 @@ void HandleInput() {
 
     };
 
+    uint16_t keys = 0;
+
     for (size_t i = 0; i < CHIP8_INPUTS; i++) {
-        CHIP8_SetKey(i, pressedKeys[i]);
+        keys |= (uint16_t)(pressedKeys[i] << i);
     }
+
+    return keys;
 }
 
-void DrawScaled() {
-    CHIP_8GFX gfx = CHIP8_GetGFX();
+void SendCommand(EMULATION_COMMAND type, int32_t value) {
+    EmulationCommand command = {.type = type, .value = value};
+    SendEmulationCommand(&command);
+}
+
+// F5 saves, F9 restores. One slot, kept in memory only.
+void HandleQuickSave() {
+    if (IsKeyPressed(KEY_F5)) {
+        SendCommand(EMULATION_COMMAND_QUICK_SAVE, 0);
+    }
+
+    if (IsKeyPressed(KEY_F9)) {
+        SendCommand(EMULATION_COMMAND_QUICK_LOAD, 0);
+    }
+}
+
+// F2 starts and stops recording from a fresh boot of the current ROM, F3 plays it back. Left and
+// right seek during playback.
+void HandleMovieKeys() {
+    if (IsKeyPressed(KEY_F2)) {
+        SendCommand(EMULATION_COMMAND_TOGGLE_RECORDING, 0);
+    }
+
+    if (IsKeyPressed(KEY_F3)) {
+        SendCommand(EMULATION_COMMAND_TOGGLE_PLAYBACK, 0);
+    }
+
+    if (IsKeyPressed(KEY_LEFT)) {
+        SendCommand(EMULATION_COMMAND_SEEK, -MOVIE_SEEK_FRAMES);
+    }
 
-    int scaledWidth = CHIP8_SCREEN_WIDTH * SCALE;
-    int scaledHeight = CHIP8_SCREEN_HEIGHT * SCALE;
+    if (IsKeyPressed(KEY_RIGHT)) {
+        SendCommand(EMULATION_COMMAND_SEEK, MOVIE_SEEK_FRAMES);
+    }
+}
 
-    int offsetX = (WIDTH - scaledWidth) / 2;
-    int offsetY = (HEIGHT - scaledHeight) / 2;
+// - and = halve and double the speed; the emulation keeps it in range.
+void HandleSpeedKeys(const EmulationFrame* frame) {
+    uint32_t ips = frame->instructionsPerSecond;
+
+    if (IsKeyPressed(KEY_MINUS)) {
+        SendCommand(EMULATION_COMMAND_SET_IPS, (int32_t)(ips / 2));
+    }
 
-    for (int x = 0; x < CHIP8_SCREEN_WIDTH; x++) {
+    if (IsKeyPressed(KEY_EQUAL)) {
+        SendCommand(EMULATION_COMMAND_SET_IPS, (int32_t)(ips * 2));
+    }
+}
 
-        for (int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+// K runs one instruction when the emulation is in step mode.
+void HandleStepKey() {
+    if (IsKeyPressed(KEY_K)) {
+        SendCommand(EMULATION_COMMAND_STEP, 0);
+    }
+}
 
-            int screenIndex = CHIP8_Convert2DTo1D(x, y, CHIP8_SCREEN_WIDTH);
+uint32_t ReadControls() {
+    uint32_t controls = ReadKeypad();
 
-            if (gfx.data[screenIndex]) {
-                DrawRectangle(offsetX + (x * SCALE), offsetY + (y * SCALE), SCALE, SCALE, WHITE);
+    if (IsKeyDown(KEY_BACKSPACE)) {
+        controls |= EMULATION_REWIND;
+    }
+
+    if (TurboFromCommandLine || IsKeyDown(KEY_TAB)) {
+        controls |= EMULATION_TURBO;
+    }
+
+    return controls;
+}
+
+// The mode picked by hand for `romPath` this session, or its default.
+COMPOSITE_MODE GetCompositeMode(const char* romPath) {
+    for (int i = 0; i < MAX_PICKED_COMPOSITE_MODES; i++) {
+        if (strcmp(PickedCompositeModes[i].romPath, romPath) == 0) {
+            return PickedCompositeModes[i].mode;
+        }
+    }
+
+    return GetDefaultCompositeMode(romPath);
+}
+
+// Remembers `mode` for the current ROM, replacing the oldest pick once the table is full.
+void PickCompositeMode(COMPOSITE_MODE mode) {
+    int slot = -1;
+
+    for (int i = 0; i < MAX_PICKED_COMPOSITE_MODES; i++) {
+        if (strcmp(PickedCompositeModes[i].romPath, CurrentRomPath) == 0) {
+            slot = i;
+        }
+    }
+
+    if (slot < 0) {
+        slot = NextPickedCompositeMode;
+        NextPickedCompositeMode = (NextPickedCompositeMode + 1) % MAX_PICKED_COMPOSITE_MODES;
+    }
+
+    snprintf(PickedCompositeModes[slot].romPath, EMULATION_MAX_ROM_PATH, "%s", CurrentRomPath);
+    PickedCompositeModes[slot].mode = mode;
+    SetCompositeMode(&ScreenCompositor, mode);
+}
+
+// Switches the compositor to `romPath`'s mode, for a ROM about to be loaded.
+void UseRomCompositeMode(const char* romPath) {
+    snprintf(CurrentRomPath, sizeof(CurrentRomPath), "%s", romPath);
+    SelectedCompositeMode = GetCompositeMode(romPath);
+    SetCompositeMode(&ScreenCompositor, (COMPOSITE_MODE)SelectedCompositeMode);
+}
+
+// The compositor's layers through CurrentFilter. Returns how many there are.
+int GetFilteredLayers(const PackedImage* layers[COMPOSITOR_FRAMES]) {
+    for (int i = 0; i < ScreenCompositor.layerCount; i++) {
+        layers[i] = FilterScreen(&ScreenFilters[i], CurrentFilter, &ScreenCompositor.layers[i],
+                                 ScreenCompositor.version);
+    }
+
+    return ScreenCompositor.layerCount;
+}
+
+// Black to white in `layerCount` steps, for a pixel lit in `level` of the layers.
+uint8_t GetLayerShade(int level, int layerCount) {
+    return (uint8_t)(0xFF * level / layerCount);
+}
+
+// Screen pixels per image pixel: the largest whole number that keeps the image within SCALE times
+// the CHIP-8's resolution, so no filter ends up with uneven pixels.
+int GetPixelSize(int width) {
+    return UPSCALED_WIDTH / width;
+}
+
+// Unpacks the 1-bit layers into ScreenPixels, layers[0]->width bytes per row, with the shades
+// UpscaleImage would give them: one pass per layer, outermost first, each lit pixel overwriting
+// the shade of the layers outside it.
+void PackScreen(const PackedImage* const* layers, int layerCount) {
+    int width = layers[0]->width;
+    int height = layers[0]->height;
+
+    memset(ScreenPixels, 0, (size_t)width * height);
+
+    for (int i = layerCount - 1; i >= 0; i--) {
+        const PackedImage* image = layers[i];
+        uint8_t shade = GetLayerShade(layerCount - i, layerCount);
+        uint8_t* pixel = ScreenPixels;
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++, pixel++) {
+                uint8_t lit = (uint8_t)-(int)((image->rows[y][x / 64] >> (63 - x % 64)) & 1);
+                *pixel = (uint8_t)((*pixel & ~lit) | (shade & lit));
             }
         }
     }
 }
 
+uint32_t ColorToPixel(Color color) {
+    uint32_t pixel;
+    memcpy(&pixel, &color, sizeof(pixel));
+    return pixel;
+}
+
+void RefreshUpscaled() {
+    if (ScreenCompositor.version == UpscaledVersion && CurrentFilter == UpscaledFilter) {
+        return;
+    }
+
+    const PackedImage* layers[COMPOSITOR_FRAMES];
+    int layerCount = GetFilteredLayers(layers);
+    int pixelSize = GetPixelSize(layers[0]->width);
+    uint32_t palette[UPSCALE_MAX_LAYERS + 1];
+
+    for (int level = 0; level <= layerCount; level++) {
+        uint8_t shade = GetLayerShade(level, layerCount);
+        palette[level] = ColorToPixel((Color){shade, shade, shade, 255});
+    }
+
+    UpscaleImage(layers, layerCount, palette, pixelSize, UpscaledPixels);
+    UpscaledWidth = layers[0]->width * pixelSize;
+    UpscaledHeight = layers[0]->height * pixelSize;
+    UpscaledVersion = ScreenCompositor.version;
+    UpscaledFilter = CurrentFilter;
+}
+
+// First "<prefix>-<n>.<extension>" that doesn't exist yet.
+const char* NextFreeFileName(const char* prefix, const char* extension) {
+    const char* fileName;
+
+    for (int i = 0;; i++) {
+        fileName = TextFormat("%s-%d.%s", prefix, i, extension);
+
+        if (!FileExists(fileName)) {
+            return fileName;
+        }
+    }
+}
+
+void StopCapture() {
+    if (Capture != NULL) {
+        fclose(Capture);
+        Capture = NULL;
+    }
+}
+
+void HandleCaptureKeys() {
+    if (IsKeyPressed(KEY_F12)) {
+        RefreshUpscaled();
+
+        Image screenshot = {
+            .data = UpscaledPixels,
+            .width = UpscaledWidth,
+            .height = UpscaledHeight,
+            .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+        };
+        ExportImage(screenshot, NextFreeFileName("screenshot", "png"));
+    }
+
+    if (IsKeyPressed(KEY_F11)) {
+        if (Capture == NULL) {
+            RefreshUpscaled();
+            Capture = fopen(NextFreeFileName("capture", "rgba"), "wb");
+            CaptureWidth = UpscaledWidth;
+            CaptureHeight = UpscaledHeight;
+        } else {
+            StopCapture();
+        }
+    }
+}
+
+// One CaptureWidth x CaptureHeight RGBA frame per displayed frame, at FPS. A filter with another
+// size ends the capture, since a raw stream can't change size.
+void CaptureFrame() {
+    if (Capture == NULL) {
+        return;
+    }
+
+    RefreshUpscaled();
+
+    if (UpscaledWidth != CaptureWidth || UpscaledHeight != CaptureHeight) {
+        StopCapture();
+        return;
+    }
+
+    fwrite(UpscaledPixels, sizeof(uint32_t), (size_t)UpscaledWidth * UpscaledHeight, Capture);
+}
+
+// One quad for the whole screen, centered, from the ScreenWidth x ScreenHeight image last uploaded
+// to the texture, `pixelSize` screen pixels per image pixel.
+void DrawScaled() {
+    int pixelSize = GetPixelSize(ScreenWidth);
+    float scaledWidth = (float)(ScreenWidth * pixelSize);
+    float scaledHeight = (float)(ScreenHeight * pixelSize);
+
+    // The CPU path already did the scaling.
+    Rectangle source = {0, 0, ScreenWidth, ScreenHeight};
+
+    if (CpuUpscale) {
+        source = (Rectangle){0, 0, scaledWidth, scaledHeight};
+    }
+
+    Rectangle destination = {(WIDTH - scaledWidth) / 2, (HEIGHT - scaledHeight) / 2, scaledWidth,
+                             scaledHeight};
+
+    DrawTexturePro(ScreenTexture, source, destination, (Vector2){0, 0}, 0.0f, WHITE);
+}
+
+bool ShouldSkipFrame() {
+    bool isLate = GetFrameTime() >= LATE_FRAME_PERIODS / FPS;
+
+    if (isLate) {
+        LateFrames++;
+    }
+
+    // A new filter is shown straight away.
+    if (isLate && ConsecutiveSkips < MaxFrameSkip && CurrentFilter == ScreenVersionFilter) {
+        ConsecutiveSkips++;
+        SkippedFrames++;
+        return true;
+    }
+
+    ConsecutiveSkips = 0;
+    return false;
+}
+
+// Uploads the screen if it changed, unless this frame is skipped, and draws it.
+void PresentScreen(bool skip) {
+    bool isStale = ScreenCompositor.version != ScreenVersion;
+    isStale |= CurrentFilter != ScreenVersionFilter;
+
+    if (!skip && isStale) {
+        const PackedImage* layers[COMPOSITOR_FRAMES];
+        int layerCount = GetFilteredLayers(layers);
+
+        if (CpuUpscale) {
+            RefreshUpscaled();
+            UpdateTextureRec(ScreenTexture, (Rectangle){0, 0, UpscaledWidth, UpscaledHeight},
+                             UpscaledPixels);
+        } else {
+            PackScreen(layers, layerCount);
+            UpdateTextureRec(ScreenTexture, (Rectangle){0, 0, layers[0]->width, layers[0]->height},
+                             ScreenPixels);
+        }
+
+        ScreenVersion = ScreenCompositor.version;
+        ScreenVersionFilter = CurrentFilter;
+        ScreenWidth = layers[0]->width;
+        ScreenHeight = layers[0]->height;
+    }
+
+    DrawScaled();
+}
+
+void DrawOverlays(const EmulationFrame* frame) {
+    if (frame->isRewinding) {
+        DrawText("<< REWIND", WIDTH - 130, 12, 20, GRAY);
+    } else if (frame->isTurbo) {
+        DrawText(TextFormat(">> %.1fx", frame->turboSpeed), WIDTH - 130, 12, 20, GRAY);
+    }
+
+    if (Capture != NULL) {
+        DrawText("CAPTURE", WIDTH - 130, 36, 20, RED);
+    }
+
+    DrawText(TextFormat("%u IPS", frame->instructionsPerSecond), 12, HEIGHT - 28, 20, GRAY);
+    DrawText(TextFormat("skipped %u  late %u", SkippedFrames, LateFrames), 160, HEIGHT - 28, 20,
+             GRAY);
+
+    if (frame->movieMode == MOVIE_MODE_RECORD) {
+        DrawText(TextFormat("REC %u", frame->movieFrameCount), 48, 12, 20, RED);
+    } else if (frame->movieMode == MOVIE_MODE_PLAY) {
+        DrawText(TextFormat("PLAY %u/%u  desyncs %u", frame->movieFrame, frame->movieFrameCount,
+                            frame->movieDesyncs),
+                 48, 12, 20, GRAY);
+    }
+}
+
 void buildRomPicker(ButtonStates* state) {
     float PanelWidth = 600;
     float PanelHeight = 300;
@@ -109,9 +495,41 @@ void buildRomPicker(ButtonStates* state) {
     free(buttons);
 }
 
-void buildUI(ButtonStates* state) {
+void buildUI(ButtonStates* state, const EmulationFrame* frame) {
     state->loadFilePressed = GuiButton((Rectangle){12, 8, 24, 24}, "#8#");
 
+    if (GuiSpinner((Rectangle){WIDTH - 250, HEIGHT - 32, 90, 24}, "Run-ahead ", &RunAheadFrames, 0,
+                   EMULATION_MAX_RUN_AHEAD_FRAMES, state->runAheadEditMode)) {
+        state->runAheadEditMode = !state->runAheadEditMode;
+    }
+
+    if (RunAheadFrames > 0) {
+        DrawText(TextFormat("%.2f ms", frame->runAheadCost * 1000.0), WIDTH - 150, HEIGHT - 28, 20,
+                 GRAY);
+    }
+
+    if (GuiSpinner((Rectangle){WIDTH - 470, HEIGHT - 32, 90, 24}, "Frame skip ", &MaxFrameSkip, 0,
+                   MAX_FRAME_SKIP, state->frameSkipEditMode)) {
+        state->frameSkipEditMode = !state->frameSkipEditMode;
+    }
+
+    DrawText("Filter", WIDTH - 620, HEIGHT - 28, 20, GRAY);
+
+    // Clicking the box steps to the next filter.
+    GuiComboBox((Rectangle){WIDTH - 560, HEIGHT - 32, 80, 24}, "None;Scale2x;Scale3x;xBR-lite",
+                &SelectedFilter);
+    CurrentFilter = (SCREEN_FILTER)SelectedFilter;
+
+    DrawText("Flicker", WIDTH - 790, HEIGHT - 28, 20, GRAY);
+
+    // Off, OR or blend for the current ROM; see ScreenCompositor.
+    GuiComboBox((Rectangle){WIDTH - 710, HEIGHT - 32, 80, 24}, "Off;OR;Blend",
+                &SelectedCompositeMode);
+
+    if (SelectedCompositeMode != (int)ScreenCompositor.mode) {
+        PickCompositeMode((COMPOSITE_MODE)SelectedCompositeMode);
+    }
+
     if (state->romPickerOpen) {
         buildRomPicker(state);
     }
@@ -124,14 +542,43 @@ void handleUI(ButtonStates* state) {
 
     if (state->selectedFilePath != NULL) {
         state->romPickerOpen = false;
+        UseRomCompositeMode(state->selectedFilePath);
 
-        CHIP8_LoadGameIntoMemory(state->selectedFilePath);
+        EmulationCommand command = {.type = EMULATION_COMMAND_LOAD_ROM};
+        snprintf(command.romPath, sizeof(command.romPath), "%s", state->selectedFilePath);
+        SendEmulationCommand(&command);
 
         state->selectedFilePath = NULL;
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    uint32_t ips = DEFAULT_IPS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--turbo") == 0) {
+            TurboFromCommandLine = true;
+        } else if (strcmp(argv[i], "--ips") == 0 && i + 1 < argc) {
+            ips = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--max-frameskip") == 0 && i + 1 < argc) {
+            int skip = atoi(argv[++i]);
+            MaxFrameSkip = skip < 0 ? 0 : skip > MAX_FRAME_SKIP ? MAX_FRAME_SKIP : skip;
+        } else if (strcmp(argv[i], "--cpu-upscale") == 0) {
+            CpuUpscale = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            for (int f = 0; f < SCREEN_FILTER_COUNT; f++) {
+                if (strcmp(argv[i + 1], GetScreenFilterName((SCREEN_FILTER)f)) == 0) {
+                    CurrentFilter = (SCREEN_FILTER)f;
+                    SelectedFilter = f;
+                }
+            }
+
+            i++;
+        }
+    }
+
+    ips = ips < SCHEDULER_MIN_IPS ? SCHEDULER_MIN_IPS : ips;
+    ips = ips > SCHEDULER_MAX_IPS ? SCHEDULER_MAX_IPS : ips;
 
     SetConfigFlags(FLAG_VSYNC_HINT | FLAG_WINDOW_HIGHDPI);
     InitWindow(WIDTH, HEIGHT, PROJNAME);
@@ -143,49 +590,82 @@ int main() {
 
     Sound beep = LoadSound("beep.wav");
 
-    ButtonStates state = {0};
+    Image screen = {
+        .data = ScreenPixels,
+        .width = FILTER_MAX_WIDTH,
+        .height = FILTER_MAX_HEIGHT,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE,
+    };
+
+    if (CpuUpscale) {
+        screen = (Image){
+            .data = UpscaledPixels,
+            .width = UPSCALED_WIDTH,
+            .height = UPSCALED_HEIGHT,
+            .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+        };
+    }
 
-    bool isGameLoaded = false;
+    ScreenTexture = LoadTextureFromImage(screen);
+    SetTextureFilter(ScreenTexture, TEXTURE_FILTER_POINT);
 
-    int success = CHIP8_LoadGameIntoMemory("roms/tests/1-chip8-logo.ch8");
+    ButtonStates state = {0};
 
     // Failed to load rom file.
-    if (success == -1) {
+    if (StartEmulation(DefaultRomPath, ips) != 0) {
         return 1;
-    } else {
-        isGameLoaded = true;
     }
 
+    UseRomCompositeMode(DefaultRomPath);
+
     while (!WindowShouldClose()) {
         BeginDrawing();
 
         handleUI(&state);
 
-        if (isGameLoaded) {
-            HandleInput();
+        // The newest frame the emulation thread has finished; it keeps running while we draw.
+        const EmulationFrame* frame = AcquireEmulationFrame();
+        PushCompositeFrame(&ScreenCompositor, &frame->gfx, frame->version);
 
-            CHIP8_DecreaseTimers();
+        HandleMovieKeys();
+        HandleSpeedKeys(frame);
+        HandleQuickSave();
+        HandleStepKey();
+        HandleCaptureKeys();
+        SetEmulationControls(ReadControls());
 
-            uint8_t soundTimer = CHIP8_GetSoundTimer();
+        if (frame->soundTimer != 0 && !IsSoundPlaying(beep)) {
+            PlaySound(beep);
+        }
 
-            if (soundTimer != 0 && !IsSoundPlaying(beep)) {
-                PlaySound(beep);
-            }
+        bool skip = ShouldSkipFrame();
 
-            for (int i = 0; i < CYCLE_MULTIPLIER; i++) {
-                StepCycle();
-            }
+        // Clicks on a frame skipped this way aren't seen by the UI, since raygui only reads input
+        // while it draws.
+        if (!skip || !SkipKeepsPicture) {
+            ClearBackground(BLACK);
+            PresentScreen(skip);
+            DrawOverlays(frame);
+            buildUI(&state, frame);
         }
 
-        ClearBackground(BLACK);
+        CaptureFrame();
 
-        DrawScaled();
-
-        buildUI(&state);
+        if (RunAheadFrames != SentRunAheadFrames) {
+            SendCommand(EMULATION_COMMAND_SET_RUN_AHEAD, RunAheadFrames);
+            SentRunAheadFrames = RunAheadFrames;
+        }
 
         EndDrawing();
     }
 
+    StopEmulation();
+
+    StopCapture();
+
+    UnloadTexture(ScreenTexture);
     CloseWindow();
     return 0;
 }
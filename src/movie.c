@@ -0,0 +1,450 @@
+#include "movie.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 2
+// Ten seconds at 60 FPS; a seek replays at most this many frames.
+#define KEYFRAME_INTERVAL 600
+// The keyframe replaces the state instead of checking it (a quick load happened there).
+#define KEYFRAME_JUMP 1u
+
+// File layout, in host byte order: the header, `run_count` MovieRun, `keyframe_count`
+// MovieKeyframeIndex sorted by frame, then that many CHIP8_STATE in the same order.
+typedef struct MovieHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t rom_hash;
+    uint32_t rom_size;
+    uint32_t state_version;
+    // Frame n replays instructions [n * ips / 60, (n + 1) * ips / 60), as the scheduler runs them.
+    uint32_t instructions_per_second;
+    // No quirk toggles in the core yet; written as 0 and rejected otherwise.
+    uint32_t quirks;
+    uint32_t random_seed;
+    uint32_t frame_count;
+    uint32_t run_count;
+    uint32_t keyframe_count;
+} MovieHeader;
+
+typedef struct MovieRun {
+    uint32_t frames;
+    uint16_t keys;
+    uint16_t reserved;
+} MovieRun;
+
+typedef struct MovieKeyframeIndex {
+    uint32_t frame;
+    uint32_t flags;
+} MovieKeyframeIndex;
+
+typedef struct MovieKeyframe {
+    MovieKeyframeIndex index;
+    CHIP8_STATE state;
+} MovieKeyframe;
+
+struct Movie {
+    MovieHeader header;
+
+    MovieRun* runs;
+    uint32_t runCapacity;
+
+    MovieKeyframe* keyframes;
+    uint32_t keyframeCapacity;
+
+    // GetMovieKeys walks forward from the last run it returned.
+    uint32_t cursorRun;
+    uint32_t cursorFrame;
+};
+
+static uint64_t HashRomFile(const char* romPath, uint32_t* romSize) {
+    FILE* file = fopen(romPath, "rb");
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+
+    *romSize = 0;
+
+    if (file == NULL) {
+        return 0;
+    }
+
+    uint8_t romData[CHIP8_MAX_ROM_SIZE + 1];
+    size_t size = fread(romData, 1, sizeof(romData), file);
+
+    fclose(file);
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ romData[i]) * 1099511628211ull;
+    }
+
+    *romSize = (uint32_t)size;
+    return hash;
+}
+
+static bool Reserve(void** items, uint32_t* capacity, uint32_t count, size_t itemSize) {
+    if (count < *capacity) {
+        return true;
+    }
+
+    uint32_t grown = *capacity == 0 ? 64 : *capacity * 2;
+    void* resized = realloc(*items, grown * itemSize);
+
+    if (resized == NULL) {
+        return false;
+    }
+
+    *items = resized;
+    *capacity = grown;
+    return true;
+}
+
+static void AddKeyframe(Movie* movie, const CHIP8* chip8, uint32_t flags) {
+    MovieHeader* header = &movie->header;
+    uint32_t frame = header->frame_count;
+
+    // A later save at the same frame (a jump, or a second quick load) replaces the earlier one.
+    if (header->keyframe_count > 0 &&
+        movie->keyframes[header->keyframe_count - 1].index.frame == frame) {
+        header->keyframe_count--;
+    }
+
+    if (!Reserve((void**)&movie->keyframes, &movie->keyframeCapacity, header->keyframe_count,
+                 sizeof(MovieKeyframe))) {
+        return;
+    }
+
+    MovieKeyframe* keyframe = &movie->keyframes[header->keyframe_count++];
+    keyframe->index = (MovieKeyframeIndex){.frame = frame, .flags = flags};
+    CHIP8_SaveState(chip8, &keyframe->state);
+}
+
+// Last keyframe at or before `frame`; the first one is always frame 0.
+static const MovieKeyframe* FindKeyframe(const Movie* movie, uint32_t frame) {
+    uint32_t low = 0;
+    uint32_t high = movie->header.keyframe_count;
+
+    while (high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+
+        if (movie->keyframes[mid].index.frame <= frame) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    return &movie->keyframes[low];
+}
+
+Movie* CreateMovie() {
+    return (Movie*)calloc(1, sizeof(Movie));
+}
+
+void DestroyMovie(Movie* movie) {
+    if (movie == NULL) {
+        return;
+    }
+
+    free(movie->runs);
+    free(movie->keyframes);
+    free(movie);
+}
+
+int BeginMovieRecording(Movie* movie, const CHIP8* chip8, const char* romPath, uint32_t seed,
+                        uint32_t instructionsPerSecond) {
+    MovieHeader* header = &movie->header;
+
+    *header = (MovieHeader){
+        .version = MOVIE_VERSION,
+        .state_version = CHIP8_STATE_VERSION,
+        .instructions_per_second = instructionsPerSecond,
+        .random_seed = seed,
+    };
+    memcpy(header->magic, MOVIE_MAGIC, sizeof(header->magic));
+    header->rom_hash = HashRomFile(romPath, &header->rom_size);
+
+    movie->cursorRun = 0;
+    movie->cursorFrame = 0;
+
+    if (header->rom_size == 0) {
+        return -1;
+    }
+
+    AddKeyframe(movie, chip8, 0);
+
+    return header->keyframe_count == 1 ? 0 : -1;
+}
+
+void RecordMovieFrame(Movie* movie, const CHIP8* chip8, uint16_t keys) {
+    MovieHeader* header = &movie->header;
+
+    bool hasKeyframe = header->keyframe_count > 0 &&
+                       movie->keyframes[header->keyframe_count - 1].index.frame ==
+                           header->frame_count;
+
+    if (header->frame_count % KEYFRAME_INTERVAL == 0 && !hasKeyframe) {
+        AddKeyframe(movie, chip8, 0);
+    }
+
+    MovieRun* last = header->run_count > 0 ? &movie->runs[header->run_count - 1] : NULL;
+
+    if (last != NULL && last->keys == keys) {
+        last->frames++;
+    } else {
+        if (!Reserve((void**)&movie->runs, &movie->runCapacity, header->run_count,
+                     sizeof(MovieRun))) {
+            return;
+        }
+
+        movie->runs[header->run_count++] = (MovieRun){.frames = 1, .keys = keys};
+    }
+
+    header->frame_count++;
+}
+
+void RecordMovieJump(Movie* movie, const CHIP8* chip8) {
+    AddKeyframe(movie, chip8, KEYFRAME_JUMP);
+}
+
+void TruncateMovie(Movie* movie, uint32_t frameCount) {
+    MovieHeader* header = &movie->header;
+
+    if (frameCount >= header->frame_count) {
+        return;
+    }
+
+    while (header->keyframe_count > 1 &&
+           movie->keyframes[header->keyframe_count - 1].index.frame > frameCount) {
+        header->keyframe_count--;
+    }
+
+    uint32_t drop = header->frame_count - frameCount;
+
+    while (drop > 0) {
+        MovieRun* last = &movie->runs[header->run_count - 1];
+
+        if (last->frames > drop) {
+            last->frames -= drop;
+            break;
+        }
+
+        drop -= last->frames;
+        header->run_count--;
+    }
+
+    header->frame_count = frameCount;
+    movie->cursorRun = 0;
+    movie->cursorFrame = 0;
+}
+
+int SaveMovie(const Movie* movie, const char* fileName) {
+    const MovieHeader* header = &movie->header;
+    FILE* file = fopen(fileName, "wb");
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    bool written = fwrite(header, sizeof(*header), 1, file) == 1;
+    written = written && fwrite(movie->runs, sizeof(MovieRun), header->run_count, file) ==
+                             header->run_count;
+
+    for (uint32_t i = 0; written && i < header->keyframe_count; i++) {
+        written = fwrite(&movie->keyframes[i].index, sizeof(MovieKeyframeIndex), 1, file) == 1;
+    }
+
+    for (uint32_t i = 0; written && i < header->keyframe_count; i++) {
+        written = fwrite(&movie->keyframes[i].state, sizeof(CHIP8_STATE), 1, file) == 1;
+    }
+
+    return fclose(file) == 0 && written ? 0 : -1;
+}
+
+// Bytes from the current position to the end of `file`, or -1 if it can't be told.
+static long GetRemainingFileSize(FILE* file) {
+    long position = ftell(file);
+
+    if (position < 0 || fseek(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+
+    long end = ftell(file);
+
+    if (fseek(file, position, SEEK_SET) != 0 || end < position) {
+        return -1;
+    }
+
+    return end - position;
+}
+
+// The runs cover exactly frame_count frames, and the keyframes start at frame 0 and go strictly
+// up to at most frame_count, so GetMovieKeys and FindKeyframe stay in range.
+static bool IsMovieConsistent(const MovieHeader* header, const MovieRun* runs,
+                              const MovieKeyframe* keyframes) {
+    uint64_t frames = 0;
+
+    for (uint32_t i = 0; i < header->run_count; i++) {
+        frames += runs[i].frames;
+    }
+
+    if (frames != header->frame_count || keyframes[0].index.frame != 0) {
+        return false;
+    }
+
+    for (uint32_t i = 1; i < header->keyframe_count; i++) {
+        if (keyframes[i].index.frame <= keyframes[i - 1].index.frame) {
+            return false;
+        }
+    }
+
+    return keyframes[header->keyframe_count - 1].index.frame <= header->frame_count;
+}
+
+int LoadMovie(Movie* movie, const char* fileName) {
+    FILE* file = fopen(fileName, "rb");
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    MovieHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == MOVIE_VERSION && header.state_version == CHIP8_STATE_VERSION &&
+                 header.quirks == 0 && header.keyframe_count > 0;
+
+    // The counts come from the file, so they must fit in what is left of it before anything is
+    // allocated for them.
+    if (valid) {
+        long remaining = GetRemainingFileSize(file);
+        uint64_t needed =
+            (uint64_t)header.run_count * sizeof(MovieRun) +
+            (uint64_t)header.keyframe_count * (sizeof(MovieKeyframeIndex) + sizeof(CHIP8_STATE));
+        valid = remaining >= 0 && needed <= (uint64_t)remaining;
+    }
+
+    MovieRun* runs = NULL;
+    MovieKeyframe* keyframes = NULL;
+
+    if (valid) {
+        runs = (MovieRun*)malloc(sizeof(MovieRun) * ((size_t)header.run_count + 1));
+        keyframes = (MovieKeyframe*)malloc(sizeof(MovieKeyframe) * (size_t)header.keyframe_count);
+        valid = runs != NULL && keyframes != NULL &&
+                fread(runs, sizeof(MovieRun), header.run_count, file) == header.run_count;
+    }
+
+    for (uint32_t i = 0; valid && i < header.keyframe_count; i++) {
+        valid = fread(&keyframes[i].index, sizeof(MovieKeyframeIndex), 1, file) == 1;
+    }
+
+    for (uint32_t i = 0; valid && i < header.keyframe_count; i++) {
+        valid = fread(&keyframes[i].state, sizeof(CHIP8_STATE), 1, file) == 1;
+    }
+
+    fclose(file);
+
+    if (!valid || !IsMovieConsistent(&header, runs, keyframes)) {
+        free(runs);
+        free(keyframes);
+        return -1;
+    }
+
+    free(movie->runs);
+    free(movie->keyframes);
+
+    movie->header = header;
+    movie->runs = runs;
+    movie->runCapacity = header.run_count + 1;
+    movie->keyframes = keyframes;
+    movie->keyframeCapacity = header.keyframe_count;
+    movie->cursorRun = 0;
+    movie->cursorFrame = 0;
+
+    return 0;
+}
+
+bool MovieMatchesRom(const Movie* movie, const char* romPath) {
+    uint32_t romSize;
+    uint64_t hash = HashRomFile(romPath, &romSize);
+
+    return romSize == movie->header.rom_size && hash == movie->header.rom_hash;
+}
+
+uint32_t GetMovieFrameCount(const Movie* movie) {
+    return movie->header.frame_count;
+}
+
+uint32_t GetMovieSeed(const Movie* movie) {
+    return movie->header.random_seed;
+}
+
+uint32_t GetMovieInstructionsPerSecond(const Movie* movie) {
+    return movie->header.instructions_per_second;
+}
+
+uint16_t GetMovieKeys(Movie* movie, uint32_t frame) {
+    if (frame < movie->cursorFrame) {
+        movie->cursorRun = 0;
+        movie->cursorFrame = 0;
+    }
+
+    while (movie->cursorRun < movie->header.run_count) {
+        const MovieRun* run = &movie->runs[movie->cursorRun];
+
+        if (frame < movie->cursorFrame + run->frames) {
+            return run->keys;
+        }
+
+        movie->cursorFrame += run->frames;
+        movie->cursorRun++;
+    }
+
+    return 0;
+}
+
+bool ApplyMovieKeyframe(const Movie* movie, CHIP8* chip8, uint32_t frame) {
+    const MovieKeyframe* keyframe = FindKeyframe(movie, frame);
+
+    if (keyframe->index.frame != frame) {
+        return true;
+    }
+
+    if (keyframe->index.flags & KEYFRAME_JUMP) {
+        CHIP8_LoadState(chip8, &keyframe->state);
+        return true;
+    }
+
+    CHIP8_STATE current;
+    CHIP8_SaveState(chip8, &current);
+
+    if (memcmp(&current, &keyframe->state, sizeof(current)) == 0) {
+        return true;
+    }
+
+    CHIP8_LoadState(chip8, &keyframe->state);
+    return false;
+}
+
+int SeekMovie(Movie* movie, CHIP8* chip8, uint32_t frame) {
+    if (frame > movie->header.frame_count) {
+        return -1;
+    }
+
+    const MovieKeyframe* keyframe = FindKeyframe(movie, frame);
+
+    if (CHIP8_LoadState(chip8, &keyframe->state) != 0) {
+        return -1;
+    }
+
+    uint32_t ips = movie->header.instructions_per_second;
+
+    for (uint32_t f = keyframe->index.frame; f < frame; f++) {
+        CHIP8_SetKeys(chip8, GetMovieKeys(movie, f));
+        CHIP8_DecreaseTimers(chip8);
+        CHIP8_RunCycles(chip8, (uint32_t)(GetFrameStartInstruction(ips, f + 1) -
+                                          GetFrameStartInstruction(ips, f)));
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Input movies. A movie is the ROM it was recorded on, the seed the core was started with, the
+// keypad mask of every frame (run-length encoded) and a full CHIP8_STATE every few seconds. The
+// keyframes let playback seek anywhere by loading the nearest earlier one and replaying at most a
+// few seconds of input, and double as a desync check during normal playback.
+//
+// Frame `n` means the frame whose keys are the n-th recorded mask; keyframe `n` is the machine
+// state right before that frame's timers tick and cycles run.
+typedef struct Movie Movie;
+
+Movie* CreateMovie();
+void DestroyMovie(Movie* movie);
+
+// Starts a new recording. `chip8` must have just loaded `romPath` and been seeded with `seed`, and
+// frames are timed by a Scheduler running at `instructionsPerSecond`.
+int BeginMovieRecording(Movie* movie, const CHIP8* chip8, const char* romPath, uint32_t seed,
+                        uint32_t instructionsPerSecond);
+// Appends the keys for the frame that is about to run.
+void RecordMovieFrame(Movie* movie, const CHIP8* chip8, uint16_t keys);
+// Records that the state was replaced (a quick load) before the next frame.
+void RecordMovieJump(Movie* movie, const CHIP8* chip8);
+// Forgets every frame from `frameCount` on, so rewinding during a recording re-records.
+void TruncateMovie(Movie* movie, uint32_t frameCount);
+
+int SaveMovie(const Movie* movie, const char* fileName);
+int LoadMovie(Movie* movie, const char* fileName);
+bool MovieMatchesRom(const Movie* movie, const char* romPath);
+
+uint32_t GetMovieFrameCount(const Movie* movie);
+uint32_t GetMovieSeed(const Movie* movie);
+uint32_t GetMovieInstructionsPerSecond(const Movie* movie);
+uint16_t GetMovieKeys(Movie* movie, uint32_t frame);
+
+// Call at the start of each played-back frame. Loads the keyframe for `frame` if there is one and
+// returns false if the running state had drifted from it.
+bool ApplyMovieKeyframe(const Movie* movie, CHIP8* chip8, uint32_t frame);
+// Puts `chip8` in the state at the start of `frame`.
+int SeekMovie(Movie* movie, CHIP8* chip8, uint32_t frame);
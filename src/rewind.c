@@ -0,0 +1,311 @@
+#include "rewind.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One keyframe per second of play; every other frame is a delta against it. Deltas grow with the
+// distance to their keyframe, so this trades keyframe size against delta size.
+#define KEYFRAME_INTERVAL 60
+// Index slots; the arena normally runs out first. 2^16 frames is about 18 minutes.
+#define MAX_FRAMES 65536
+
+// Encoded stream: a byte below 0x80 is followed by that many + 1 literal bytes, a byte with the
+// top bit set is a run of (byte & 0x7F) + 1 zero bytes.
+#define RUN_LIMIT 128
+#define ZERO_RUN 0x80
+#define MAX_ENCODED_SIZE (sizeof(CHIP8_STATE) + (sizeof(CHIP8_STATE) + RUN_LIMIT - 1) / RUN_LIMIT)
+
+typedef struct RewindFrame {
+    uint32_t offset;
+    uint16_t size;
+    bool keyframe;
+} RewindFrame;
+
+struct RewindBuffer {
+    uint8_t* arena;
+    size_t arenaSize;
+    // Where the next frame goes. Frames are written in order, so the live data always runs from
+    // the oldest frame's offset up to `head`, possibly wrapping once.
+    size_t head;
+    size_t bytesUsed;
+
+    RewindFrame* frames;
+    size_t first;
+    size_t count;
+
+    // Decoded keyframe the newest frame was encoded against, and how many frames since it.
+    CHIP8_STATE keyframe;
+    size_t sinceKeyframe;
+
+    uint8_t scratch[MAX_ENCODED_SIZE];
+};
+
+static const CHIP8_STATE ZeroState;
+
+static size_t FrameAt(const RewindBuffer* rewind, size_t age) {
+    return (rewind->first + age) % MAX_FRAMES;
+}
+
+// Length of the common prefix of `a` and `b`, up to `limit`. Most of a state is unchanged from its
+// keyframe, so it compares a word at a time before falling back to bytes.
+static size_t EqualPrefix(const uint8_t* a, const uint8_t* b, size_t limit) {
+    size_t n = 0;
+
+    while (n + sizeof(uint64_t) <= limit) {
+        uint64_t wordA;
+        uint64_t wordB;
+        memcpy(&wordA, a + n, sizeof(wordA));
+        memcpy(&wordB, b + n, sizeof(wordB));
+
+        if (wordA != wordB) {
+            break;
+        }
+
+        n += sizeof(uint64_t);
+    }
+
+    while (n < limit && a[n] == b[n]) {
+        n++;
+    }
+
+    return n;
+}
+
+static size_t Encode(const CHIP8_STATE* state, const CHIP8_STATE* base, uint8_t* out) {
+    const uint8_t* a = (const uint8_t*)state;
+    const uint8_t* b = (const uint8_t*)base;
+    size_t size = sizeof(CHIP8_STATE);
+    size_t written = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        size_t left = size - i;
+        size_t run = EqualPrefix(a + i, b + i, left < RUN_LIMIT ? left : RUN_LIMIT);
+
+        if (run > 0) {
+            out[written++] = (uint8_t)(ZERO_RUN | (run - 1));
+            i += run;
+            continue;
+        }
+
+        // Literal run up to the next pair of equal bytes; a lone equal byte is cheaper inline.
+        while (i + run < size && run < RUN_LIMIT &&
+               (a[i + run] != b[i + run] ||
+                (i + run + 1 < size && a[i + run + 1] != b[i + run + 1]))) {
+            run++;
+        }
+
+        out[written++] = (uint8_t)(run - 1);
+
+        for (size_t j = 0; j < run; j++) {
+            out[written++] = a[i + j] ^ b[i + j];
+        }
+
+        i += run;
+    }
+
+    return written;
+}
+
+static void Decode(const uint8_t* in, size_t inSize, const CHIP8_STATE* base, CHIP8_STATE* state) {
+    uint8_t* out = (uint8_t*)state;
+    const uint8_t* b = (const uint8_t*)base;
+    size_t o = 0;
+
+    memcpy(state, base, sizeof(CHIP8_STATE));
+
+    for (size_t i = 0; i < inSize && o < sizeof(CHIP8_STATE);) {
+        uint8_t token = in[i++];
+        size_t run = (size_t)(token & ~ZERO_RUN) + 1;
+
+        if (token & ZERO_RUN) {
+            o += run;
+            continue;
+        }
+
+        for (size_t j = 0; j < run; j++, o++) {
+            out[o] = b[o] ^ in[i++];
+        }
+    }
+}
+
+static void DropOldest(RewindBuffer* rewind) {
+    RewindFrame* frame = &rewind->frames[rewind->first];
+
+    rewind->bytesUsed -= frame->size;
+    rewind->first = (rewind->first + 1) % MAX_FRAMES;
+    rewind->count--;
+
+    if (rewind->count == 0) {
+        rewind->head = 0;
+    }
+}
+
+// Drops whole keyframe groups, oldest first, since a delta is useless without its keyframe.
+static void DropOldestGroup(RewindBuffer* rewind) {
+    do {
+        DropOldest(rewind);
+    } while (rewind->count > 0 && !rewind->frames[rewind->first].keyframe);
+}
+
+// Makes room for `size` contiguous bytes and returns their offset.
+static size_t Reserve(RewindBuffer* rewind, size_t size) {
+    if (rewind->count == MAX_FRAMES) {
+        DropOldestGroup(rewind);
+    }
+
+    while (rewind->count > 0) {
+        size_t oldest = rewind->frames[rewind->first].offset;
+
+        if (oldest < rewind->head) {
+            // Free space is the tail of the arena and everything before the oldest frame.
+            if (rewind->head + size <= rewind->arenaSize) {
+                break;
+            }
+
+            if (size <= oldest) {
+                rewind->head = 0;
+                break;
+            }
+        } else if (rewind->head + size <= oldest) {
+            // Already wrapped: free space is the gap up to the oldest frame.
+            break;
+        }
+
+        DropOldestGroup(rewind);
+    }
+
+    size_t offset = rewind->head;
+    rewind->head += size;
+    return offset;
+}
+
+RewindBuffer* CreateRewindBuffer(size_t arenaBytes) {
+    if (arenaBytes < MAX_ENCODED_SIZE) {
+        return NULL;
+    }
+
+    RewindBuffer* rewind = (RewindBuffer*)calloc(1, sizeof(RewindBuffer));
+
+    if (rewind == NULL) {
+        return NULL;
+    }
+
+    rewind->arena = (uint8_t*)malloc(arenaBytes);
+    rewind->frames = (RewindFrame*)malloc(sizeof(RewindFrame) * MAX_FRAMES);
+
+    if (rewind->arena == NULL || rewind->frames == NULL) {
+        DestroyRewindBuffer(rewind);
+        return NULL;
+    }
+
+    rewind->arenaSize = arenaBytes;
+
+    return rewind;
+}
+
+void DestroyRewindBuffer(RewindBuffer* rewind) {
+    if (rewind == NULL) {
+        return;
+    }
+
+    free(rewind->arena);
+    free(rewind->frames);
+    free(rewind);
+}
+
+void ClearRewindBuffer(RewindBuffer* rewind) {
+    rewind->head = 0;
+    rewind->bytesUsed = 0;
+    rewind->first = 0;
+    rewind->count = 0;
+    rewind->sinceKeyframe = 0;
+}
+
+void PushRewindFrame(RewindBuffer* rewind, const CHIP8_STATE* state) {
+    bool keyframe = rewind->count == 0 || rewind->sinceKeyframe + 1 >= KEYFRAME_INTERVAL;
+    size_t size = Encode(state, keyframe ? &ZeroState : &rewind->keyframe, rewind->scratch);
+    size_t offset = Reserve(rewind, size);
+
+    // Making room can drop the group this delta belongs to when the arena is tiny; start over
+    // from a keyframe then.
+    if (!keyframe && rewind->count == 0) {
+        keyframe = true;
+        size = Encode(state, &ZeroState, rewind->scratch);
+        offset = Reserve(rewind, size);
+    }
+
+    memcpy(rewind->arena + offset, rewind->scratch, size);
+
+    rewind->frames[FrameAt(rewind, rewind->count)] = (RewindFrame){
+        .offset = (uint32_t)offset,
+        .size = (uint16_t)size,
+        .keyframe = keyframe,
+    };
+    rewind->count++;
+    rewind->bytesUsed += size;
+
+    if (keyframe) {
+        rewind->keyframe = *state;
+        rewind->sinceKeyframe = 0;
+    } else {
+        rewind->sinceKeyframe++;
+    }
+}
+
+void DropNewestRewindFrame(RewindBuffer* rewind) {
+    if (rewind->count == 0) {
+        return;
+    }
+
+    const RewindFrame* dropped = &rewind->frames[FrameAt(rewind, rewind->count - 1)];
+    rewind->bytesUsed -= dropped->size;
+    rewind->head = dropped->offset;
+    rewind->count--;
+
+    if (rewind->count == 0) {
+        return;
+    }
+
+    if (!dropped->keyframe) {
+        rewind->sinceKeyframe--;
+        return;
+    }
+
+    // Stepped back into the previous group; find and decode its keyframe.
+    size_t age = rewind->count - 1;
+
+    while (!rewind->frames[FrameAt(rewind, age)].keyframe) {
+        age--;
+    }
+
+    const RewindFrame* key = &rewind->frames[FrameAt(rewind, age)];
+    Decode(rewind->arena + key->offset, key->size, &ZeroState, &rewind->keyframe);
+    rewind->sinceKeyframe = rewind->count - 1 - age;
+}
+
+bool StepRewindBack(RewindBuffer* rewind, CHIP8_STATE* state) {
+    if (rewind->count < 2) {
+        return false;
+    }
+
+    DropNewestRewindFrame(rewind);
+
+    const RewindFrame* newest = &rewind->frames[FrameAt(rewind, rewind->count - 1)];
+
+    if (newest->keyframe) {
+        *state = rewind->keyframe;
+    } else {
+        Decode(rewind->arena + newest->offset, newest->size, &rewind->keyframe, state);
+    }
+
+    return true;
+}
+
+size_t GetRewindFrameCount(const RewindBuffer* rewind) {
+    return rewind->count;
+}
+
+size_t GetRewindBytesUsed(const RewindBuffer* rewind) {
+    return rewind->bytesUsed;
+}
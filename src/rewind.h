@@ -0,0 +1,28 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Frame history for rewinding. Every pushed frame is a CHIP8_STATE XORed against the last
+// keyframe and run-length encoded, so a frame where only a few registers and rows changed costs a
+// few dozen bytes. Keyframes are encoded the same way against an all-zero state. The encoded
+// frames live in one fixed arena used as a ring: once it is full the oldest second of history is
+// dropped to make room.
+typedef struct RewindBuffer RewindBuffer;
+
+// `arenaBytes` bounds the encoded history; nothing else is allocated after creation.
+RewindBuffer* CreateRewindBuffer(size_t arenaBytes);
+void DestroyRewindBuffer(RewindBuffer* rewind);
+void ClearRewindBuffer(RewindBuffer* rewind);
+
+// Appends the state at the end of an emulated frame.
+void PushRewindFrame(RewindBuffer* rewind, const CHIP8_STATE* state);
+// Drops the newest frame and writes the one before it into `state`. Returns false when there is
+// nothing older left.
+bool StepRewindBack(RewindBuffer* rewind, CHIP8_STATE* state);
+// Forgets the newest frame without decoding anything.
+void DropNewestRewindFrame(RewindBuffer* rewind);
+
+size_t GetRewindFrameCount(const RewindBuffer* rewind);
+size_t GetRewindBytesUsed(const RewindBuffer* rewind);
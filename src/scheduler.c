@@ -0,0 +1,74 @@
+#include "scheduler.h"
+
+#define MAX_CATCH_UP_SECONDS 0.25
+
+void ResetScheduler(Scheduler* scheduler, uint32_t instructionsPerSecond, double now) {
+    scheduler->instructionsPerSecond = instructionsPerSecond;
+    scheduler->executed = 0;
+    scheduler->frame = 0;
+    SyncSchedulerClock(scheduler, now);
+}
+
+void SeekScheduler(Scheduler* scheduler, uint32_t frame) {
+    scheduler->frame = frame;
+    scheduler->executed = GetFrameStartInstruction(scheduler->instructionsPerSecond, frame);
+}
+
+void SyncSchedulerClock(Scheduler* scheduler, double now) {
+    scheduler->lastTime = now;
+    scheduler->owedInstructions = 0.0;
+}
+
+uint64_t AdvanceSchedulerClock(Scheduler* scheduler, double now) {
+    double elapsed = now - scheduler->lastTime;
+    scheduler->lastTime = now;
+
+    if (elapsed > MAX_CATCH_UP_SECONDS) {
+        elapsed = MAX_CATCH_UP_SECONDS;
+    }
+
+    // The fraction left over is carried, so e.g. 700 IPS at 144 Hz still averages 700.
+    scheduler->owedInstructions += elapsed * scheduler->instructionsPerSecond;
+
+    uint64_t instructions = (uint64_t)scheduler->owedInstructions;
+    scheduler->owedInstructions -= (double)instructions;
+
+    return instructions;
+}
+
+void RunScheduled(Scheduler* scheduler, CHIP8* chip8, uint64_t instructions) {
+    uint32_t ips = scheduler->instructionsPerSecond;
+
+    while (instructions > 0) {
+        if (scheduler->executed == GetFrameStartInstruction(ips, scheduler->frame)) {
+            scheduler->beginFrame(scheduler->frame);
+            CHIP8_DecreaseTimers(chip8);
+            scheduler->frame++;
+        }
+
+        // Up to the end of the frame just begun, where the next timer tick goes.
+        uint64_t frameEnd = GetFrameStartInstruction(ips, scheduler->frame);
+        uint64_t batch = frameEnd - scheduler->executed;
+
+        if (batch > instructions) {
+            batch = instructions;
+        }
+
+        CHIP8_RunCycles(chip8, (uint32_t)batch);
+        scheduler->executed += batch;
+        instructions -= batch;
+
+        if (scheduler->executed == frameEnd) {
+            scheduler->endFrame(scheduler->frame - 1);
+        }
+    }
+}
+
+uint32_t GetCompletedFrames(const Scheduler* scheduler) {
+    uint64_t frameStart = GetFrameStartInstruction(scheduler->instructionsPerSecond,
+                                                   scheduler->frame);
+
+    // Mid-frame, the last frame begun hasn't completed yet.
+    return scheduler->executed == frameStart || scheduler->frame == 0 ? scheduler->frame
+                                                                      : scheduler->frame - 1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "chip8.h"
+#include <stdint.h>
+
+#define SCHEDULER_TIMER_HZ 60
+#define SCHEDULER_MIN_IPS 500
+#define SCHEDULER_MAX_IPS 1000000
+
+// Called at the start of every emulated 1/60 s frame, before its timer tick; the front end sets
+// the frame's keys here.
+typedef void (*SchedulerFrameFunc)(uint32_t frame);
+
+// Fixed-timestep scheduler. Wall time only decides how many instructions are owed; where the timer
+// ticks fall is fixed by the instruction count alone. Frame `n` starts at instruction
+// n * ips / 60 of the current epoch, so the same input replays the same way whatever the display
+// rate, and a dropped display frame is made up on the next one.
+typedef struct Scheduler {
+    uint32_t instructionsPerSecond;
+    SchedulerFrameFunc beginFrame;
+    // Called once a frame's last instruction has run.
+    SchedulerFrameFunc endFrame;
+
+    double lastTime;
+    double owedInstructions;
+    // Instructions run and frames begun since the epoch started.
+    uint64_t executed;
+    uint32_t frame;
+} Scheduler;
+
+static inline uint64_t GetFrameStartInstruction(uint32_t instructionsPerSecond, uint32_t frame) {
+    return (uint64_t)frame * instructionsPerSecond / SCHEDULER_TIMER_HZ;
+}
+
+// Starts a new epoch at frame 0. `now` is a monotonic clock in seconds.
+void ResetScheduler(Scheduler* scheduler, uint32_t instructionsPerSecond, double now);
+// Moves to the start of `frame`, for when the machine state was replaced by that frame's state.
+void SeekScheduler(Scheduler* scheduler, uint32_t frame);
+// Drops any owed time, for after the machine was driven by something other than the clock.
+void SyncSchedulerClock(Scheduler* scheduler, double now);
+// Returns how many instructions the time since the last call is worth. At most a quarter second is
+// made up at once, so a stall doesn't turn into a burst of fast-forward.
+uint64_t AdvanceSchedulerClock(Scheduler* scheduler, double now);
+// Runs `instructions` instructions, beginning and ending frames where their boundaries fall.
+void RunScheduled(Scheduler* scheduler, CHIP8* chip8, uint64_t instructions);
+uint32_t GetCompletedFrames(const Scheduler* scheduler);
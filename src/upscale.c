@@ -0,0 +1,125 @@
+#include "upscale.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define UPSCALE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UPSCALE_SSE2 1
+#endif
+
+// Each pixel is written with whole-vector stores, so the last one can spill up to a vector past the
+// end of its scanline; the next pixel's stores overwrite the spill. A row is expanded 64 pixels
+// (one word) at a time.
+#define SCANLINE_SLACK 8
+#define SCANLINE_SIZE (FILTER_MAX_WIDTH * UPSCALE_MAX_SCALE + SCANLINE_SLACK)
+
+#if defined(UPSCALE_AVX2)
+static void ExpandRow(const uint64_t* rows, int layerCount, const uint32_t* palette, int scale,
+                      uint32_t* out) {
+    const __m256i bits = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+    for (int byte = 0; byte < 8; byte++) {
+        __m256i colors = _mm256_set1_epi32((int)palette[0]);
+
+        // Outermost layer first, so the innermost lit one picks the color.
+        for (int i = layerCount - 1; i >= 0; i--) {
+            __m256i source = _mm256_set1_epi32((int)(rows[i] >> (56 - 8 * byte)) & 0xFF);
+            __m256i lit = _mm256_cmpeq_epi32(_mm256_and_si256(source, bits), bits);
+            __m256i color = _mm256_set1_epi32((int)palette[layerCount - i]);
+            colors = _mm256_blendv_epi8(colors, color, lit);
+        }
+
+        for (int i = 0; i < 8; i++) {
+            __m256i color = _mm256_permutevar8x32_epi32(colors, _mm256_set1_epi32(i));
+            uint32_t* pixel = out + (byte * 8 + i) * scale;
+
+            for (int s = 0; s < scale; s += 8) {
+                _mm256_storeu_si256((__m256i*)(pixel + s), color);
+            }
+        }
+    }
+}
+#elif defined(UPSCALE_SSE2)
+static void StoreRun(uint32_t* out, __m128i color, int scale) {
+    for (int s = 0; s < scale; s += 4) {
+        _mm_storeu_si128((__m128i*)(out + s), color);
+    }
+}
+
+static void ExpandRow(const uint64_t* rows, int layerCount, const uint32_t* palette, int scale,
+                      uint32_t* out) {
+    const __m128i bits[2] = {_mm_setr_epi32(0x80, 0x40, 0x20, 0x10),
+                             _mm_setr_epi32(0x08, 0x04, 0x02, 0x01)};
+
+    for (int byte = 0; byte < 8; byte++) {
+        for (int half = 0; half < 2; half++) {
+            __m128i colors = _mm_set1_epi32((int)palette[0]);
+
+            // Outermost layer first, so the innermost lit one picks the color.
+            for (int i = layerCount - 1; i >= 0; i--) {
+                __m128i source = _mm_set1_epi32((int)(rows[i] >> (56 - 8 * byte)) & 0xFF);
+                __m128i lit = _mm_cmpeq_epi32(_mm_and_si128(source, bits[half]), bits[half]);
+                __m128i color = _mm_set1_epi32((int)palette[layerCount - i]);
+                colors = _mm_or_si128(_mm_and_si128(lit, color), _mm_andnot_si128(lit, colors));
+            }
+
+            uint32_t* pixel = out + (byte * 8 + half * 4) * scale;
+
+            // Left to right, so each run overwrites the spill of the one before it.
+            StoreRun(pixel, _mm_shuffle_epi32(colors, 0x00), scale);
+            StoreRun(pixel + scale, _mm_shuffle_epi32(colors, 0x55), scale);
+            StoreRun(pixel + 2 * scale, _mm_shuffle_epi32(colors, 0xAA), scale);
+            StoreRun(pixel + 3 * scale, _mm_shuffle_epi32(colors, 0xFF), scale);
+        }
+    }
+}
+#else
+static void ExpandRow(const uint64_t* rows, int layerCount, const uint32_t* palette, int scale,
+                      uint32_t* out) {
+    for (int x = 0; x < 64; x++) {
+        int level = 0;
+
+        for (int i = layerCount - 1; i >= 0; i--) {
+            int lit = -(int)((rows[i] >> (63 - x)) & 1);
+            level = (level & ~lit) | ((layerCount - i) & lit);
+        }
+
+        uint32_t color = palette[level];
+
+        for (int s = 0; s < scale; s++) {
+            *out++ = color;
+        }
+    }
+}
+#endif
+
+void UpscaleImage(const PackedImage* const* layers, int layerCount, const uint32_t* palette,
+                  int scale, uint32_t* pixels) {
+    if (scale < 1 || scale > UPSCALE_MAX_SCALE || layerCount < 1 ||
+        layerCount > UPSCALE_MAX_LAYERS) {
+        return;
+    }
+
+    const PackedImage* image = layers[0];
+    uint32_t scanline[SCANLINE_SIZE];
+    size_t width = (size_t)image->width * scale;
+
+    // Every output row of a source row is the same, so each is expanded once and copied.
+    for (int y = 0; y < image->height; y++) {
+        for (int word = 0; word < image->width / 64; word++) {
+            uint64_t rows[UPSCALE_MAX_LAYERS];
+
+            for (int i = 0; i < layerCount; i++) {
+                rows[i] = layers[i]->rows[y][word];
+            }
+
+            ExpandRow(rows, layerCount, palette, scale, scanline + word * 64 * scale);
+        }
+
+        for (int s = 0; s < scale; s++) {
+            memcpy(pixels + ((size_t)y * scale + s) * width, scanline, width * sizeof(uint32_t));
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "compositor.h"
+#include "filter.h"
+#include <stdint.h>
+
+#define UPSCALE_MAX_SCALE 16
+#define UPSCALE_MAX_LAYERS COMPOSITOR_FRAMES
+
+// Expands `layerCount` (1 to UPSCALE_MAX_LAYERS) same-sized 1-bit images, such as the filtered
+// layers of a Compositor, into one RGBA8 image `scale` times their size (1 to UPSCALE_MAX_SCALE),
+// row-major with no padding: (width * scale) x (height * scale). A pixel lit in layers[i] and no
+// layer before it is palette[layerCount - i], and one lit in none is palette[0]; colors are the
+// four bytes R, G, B, A read as one uint32_t. Eight source pixels at a time become colors with a
+// compare and a select per layer, on SSE2 or AVX2 when the build targets them.
+void UpscaleImage(const PackedImage* const* layers, int layerCount, const uint32_t* palette,
+                  int scale, uint32_t* pixels);
@@ -0,0 +1,455 @@
+// Ahead-of-time recompiler: turns a CHIP-8 ROM into a C translation unit that runs it natively on
+// top of libchip8's machine state.
+//
+//   chip8-aot [-n name] [-m] rom out.c
+//
+// Code is recovered by following control flow from 0x200. Every basic block becomes a label in
+// <name>_RunCycles whose instructions are the interpreter's own Op* functions with constant
+// operands, so the compiler can fold the decoding away while the semantics stay identical. Blocks
+// chain with gotos; a pc that isn't a recovered block (BNNN targets, 00EE into code we never saw,
+// data executed as code) runs through the table interpreter until control lands on a known block
+// again. Every block compares its bytes against the ROM it was translated from before running, so
+// self-modifying code and a different ROM in memory fall back to the interpreter too.
+//
+// The generated file includes chip8_internal.h: compile it with include/chip8 and src/chip8 on the
+// include path and link it against the static libchip8 (the chip8 project, CHIP8_SHARED left
+// undefined). It calls internals such as CHIP8_RunTableDispatch that the shared library doesn't
+// export. With -m it also gets a main() that replays the ROM through both the translated code and
+// the interpreter and compares the results.
+
+#include "chip8_internal.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum OPERANDS {
+    OPERANDS_NONE,
+    OPERANDS_NNN,
+    OPERANDS_X,
+    OPERANDS_XY,
+    OPERANDS_XNN,
+    OPERANDS_XYN,
+} OPERANDS;
+
+typedef struct OpInfo {
+    const char* function;
+    OPERANDS operands;
+} OpInfo;
+
+static const OpInfo OpInfos[CHIP8_OP_COUNT] = {
+    [CHIP8_OP_NOP] = {NULL, OPERANDS_NONE},
+    [CHIP8_OP_00E0] = {"Op00E0", OPERANDS_NONE},
+    [CHIP8_OP_00EE] = {"Op00EE", OPERANDS_NONE},
+    [CHIP8_OP_1NNN] = {"Op1NNN", OPERANDS_NNN},
+    [CHIP8_OP_2NNN] = {"Op2NNN", OPERANDS_NNN},
+    [CHIP8_OP_3XNN] = {"Op3XNN", OPERANDS_XNN},
+    [CHIP8_OP_4XNN] = {"Op4XNN", OPERANDS_XNN},
+    [CHIP8_OP_5XY0] = {"Op5XY0", OPERANDS_XY},
+    [CHIP8_OP_6XNN] = {"Op6XNN", OPERANDS_XNN},
+    [CHIP8_OP_7XNN] = {"Op7XNN", OPERANDS_XNN},
+    [CHIP8_OP_8XY0] = {"Op8XY0", OPERANDS_XY},
+    [CHIP8_OP_8XY1] = {"Op8XY1", OPERANDS_XY},
+    [CHIP8_OP_8XY2] = {"Op8XY2", OPERANDS_XY},
+    [CHIP8_OP_8XY3] = {"Op8XY3", OPERANDS_XY},
+    [CHIP8_OP_8XY4] = {"Op8XY4", OPERANDS_XY},
+    [CHIP8_OP_8XY5] = {"Op8XY5", OPERANDS_XY},
+    [CHIP8_OP_8XY6] = {"Op8XY6", OPERANDS_X},
+    [CHIP8_OP_8XY7] = {"Op8XY7", OPERANDS_XY},
+    [CHIP8_OP_8XYE] = {"Op8XYE", OPERANDS_X},
+    [CHIP8_OP_9XY0] = {"Op9XY0", OPERANDS_XY},
+    [CHIP8_OP_ANNN] = {"OpANNN", OPERANDS_NNN},
+    [CHIP8_OP_BNNN] = {"OpBNNN", OPERANDS_NNN},
+    [CHIP8_OP_CXNN] = {"OpCXNN", OPERANDS_XNN},
+    [CHIP8_OP_DXYN] = {"OpDXYN", OPERANDS_XYN},
+    [CHIP8_OP_EX9E] = {"OpEX9E", OPERANDS_X},
+    [CHIP8_OP_EXA1] = {"OpEXA1", OPERANDS_X},
+    [CHIP8_OP_FX07] = {"OpFX07", OPERANDS_X},
+    [CHIP8_OP_FX0A] = {"OpFX0A", OPERANDS_X},
+    [CHIP8_OP_FX15] = {"OpFX15", OPERANDS_X},
+    [CHIP8_OP_FX18] = {"OpFX18", OPERANDS_X},
+    [CHIP8_OP_FX1E] = {"OpFX1E", OPERANDS_X},
+    [CHIP8_OP_FX29] = {"OpFX29", OPERANDS_X},
+    [CHIP8_OP_FX33] = {"OpFX33", OPERANDS_X},
+    [CHIP8_OP_FX55] = {"OpFX55", OPERANDS_X},
+    [CHIP8_OP_FX65] = {"OpFX65", OPERANDS_X},
+};
+
+typedef struct Program {
+    uint8_t rom[CHIP8_MAX_ROM_SIZE];
+    size_t size;
+
+    // Indexed by CHIP-8 address.
+    bool leader[CHIP8_MEMORY_SIZE];
+    bool visited[CHIP8_MEMORY_SIZE];
+} Program;
+
+static bool InRom(const Program* program, uint32_t address) {
+    return address >= CHIP8_PROGRAM_START && address + 1 < CHIP8_PROGRAM_START + program->size;
+}
+
+static uint16_t OpcodeAt(const Program* program, uint16_t address) {
+    const uint8_t* bytes = &program->rom[address - CHIP8_PROGRAM_START];
+    return (uint16_t)((bytes[0] << 8) | bytes[1]);
+}
+
+static bool IsSkip(CHIP8_OP op) {
+    return op == CHIP8_OP_3XNN || op == CHIP8_OP_4XNN || op == CHIP8_OP_5XY0 ||
+           op == CHIP8_OP_9XY0 || op == CHIP8_OP_EX9E || op == CHIP8_OP_EXA1;
+}
+
+// Instructions after which the block ends. FX33/FX55 are included because they may have just
+// rewritten the rest of the block.
+static bool EndsBlock(CHIP8_OP op) {
+    return IsSkip(op) || op == CHIP8_OP_00EE || op == CHIP8_OP_1NNN || op == CHIP8_OP_2NNN ||
+           op == CHIP8_OP_BNNN || op == CHIP8_OP_FX0A || op == CHIP8_OP_FX33 ||
+           op == CHIP8_OP_FX55;
+}
+
+static void AddLeader(Program* program, uint16_t* worklist, int* pending, uint32_t address) {
+    if (!InRom(program, address) || program->leader[address]) {
+        return;
+    }
+
+    program->leader[address] = true;
+    worklist[(*pending)++] = (uint16_t)address;
+}
+
+static void RecoverCode(Program* program) {
+    uint16_t worklist[CHIP8_MEMORY_SIZE];
+    int pending = 0;
+
+    AddLeader(program, worklist, &pending, CHIP8_PROGRAM_START);
+
+    while (pending > 0) {
+        uint16_t address = worklist[--pending];
+
+        while (InRom(program, address) && !program->visited[address]) {
+            program->visited[address] = true;
+
+            uint16_t opcode = OpcodeAt(program, address);
+            CHIP8_OP op = CHIP8_DecodeOp(opcode);
+
+            if (op == CHIP8_OP_1NNN || op == CHIP8_OP_2NNN) {
+                AddLeader(program, worklist, &pending, OPCODE_NNN(opcode));
+            }
+
+            if (IsSkip(op)) {
+                AddLeader(program, worklist, &pending, address + 4);
+            }
+
+            if (EndsBlock(op)) {
+                // Calls return to the next instruction; 1NNN, 00EE and BNNN never fall through.
+                if (op != CHIP8_OP_1NNN && op != CHIP8_OP_00EE && op != CHIP8_OP_BNNN) {
+                    AddLeader(program, worklist, &pending, address + 2);
+                }
+                break;
+            }
+
+            address += 2;
+        }
+    }
+}
+
+// Number of instructions in the block starting at `start`.
+static int BlockLength(const Program* program, uint16_t start) {
+    int count = 0;
+
+    for (uint32_t address = start; InRom(program, address); address += 2) {
+        count += 1;
+
+        if (EndsBlock(CHIP8_DecodeOp(OpcodeAt(program, (uint16_t)address))) ||
+            (InRom(program, address + 2) && program->leader[address + 2])) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+static void EmitGoto(FILE* out, const Program* program, uint32_t address) {
+    if (InRom(program, address) && program->leader[address]) {
+        fprintf(out, "        goto block_%03X;\n", address);
+    } else {
+        fprintf(out, "        continue;\n");
+    }
+}
+
+static void EmitCall(FILE* out, CHIP8_OP op, uint16_t opcode) {
+    const OpInfo* info = &OpInfos[op];
+
+    if (info->function == NULL) {
+        return;
+    }
+
+    fprintf(out, "        %s(chip8", info->function);
+
+    switch (info->operands) {
+        case OPERANDS_NONE:
+            break;
+        case OPERANDS_NNN:
+            fprintf(out, ", 0x%03X", OPCODE_NNN(opcode));
+            break;
+        case OPERANDS_X:
+            fprintf(out, ", 0x%X", OPCODE_X(opcode));
+            break;
+        case OPERANDS_XY:
+            fprintf(out, ", 0x%X, 0x%X", OPCODE_X(opcode), OPCODE_Y(opcode));
+            break;
+        case OPERANDS_XNN:
+            fprintf(out, ", 0x%X, 0x%02X", OPCODE_X(opcode), OPCODE_NN(opcode));
+            break;
+        case OPERANDS_XYN:
+            fprintf(out, ", 0x%X, 0x%X, 0x%X", OPCODE_X(opcode), OPCODE_Y(opcode),
+                    OPCODE_N(opcode));
+            break;
+    }
+
+    fprintf(out, ");\n");
+}
+
+static void EmitBlock(FILE* out, const Program* program, uint16_t start) {
+    int count = BlockLength(program, start);
+
+    fprintf(out, "\n    block_%03X:\n", start);
+    fprintf(out, "        ENTER_BLOCK(0x%03X, %d);\n", start, count);
+
+    for (int i = 0; i < count; i++) {
+        uint16_t address = (uint16_t)(start + i * 2);
+        uint16_t opcode = OpcodeAt(program, address);
+        CHIP8_OP op = CHIP8_DecodeOp(opcode);
+
+        // Handlers expect pc to already point past the instruction, like the interpreter leaves it.
+        fprintf(out, "        chip8->pc_counter = 0x%03X; // %04X\n", address + 2, opcode);
+        EmitCall(out, op, opcode);
+
+        if (IsSkip(op)) {
+            fprintf(out, "        if (chip8->pc_counter == 0x%03X) {\n", address + 4);
+            fprintf(out, "    ");
+            EmitGoto(out, program, address + 4);
+            fprintf(out, "        }\n");
+            EmitGoto(out, program, address + 2);
+            return;
+        }
+
+        switch (op) {
+            case CHIP8_OP_1NNN:
+            case CHIP8_OP_2NNN:
+                EmitGoto(out, program, OPCODE_NNN(opcode));
+                return;
+            case CHIP8_OP_00EE:
+            case CHIP8_OP_BNNN:
+            case CHIP8_OP_FX0A:
+            case CHIP8_OP_FX33:
+            case CHIP8_OP_FX55:
+                // Next pc is only known at run time, or memory may have changed under us.
+                fprintf(out, "        continue;\n");
+                return;
+            default:
+                break;
+        }
+    }
+
+    EmitGoto(out, program, start + count * 2);
+}
+
+static void EmitMain(FILE* out, const char* name) {
+    fprintf(out,
+            "\n"
+            "#include <stdio.h>\n"
+            "#include <stdlib.h>\n"
+            "#include <time.h>\n"
+            "\n"
+            "// Regression replay: the same key sequence through the translated code and the\n"
+            "// interpreter, compared on the final framebuffer.\n"
+            "//\n"
+            "//   %s [cycles]\n"
+            "\n"
+            "static double NowSeconds() {\n"
+            "    struct timespec now;\n"
+            "    timespec_get(&now, TIME_UTC);\n"
+            "    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;\n"
+            "}\n"
+            "\n"
+            "static double Replay(CHIP8* chip8, uint32_t cycles, bool translated) {\n"
+            "    double start = NowSeconds();\n"
+            "\n"
+            "    for (uint32_t done = 0, frame = 0; done < cycles; done += 1000, frame++) {\n"
+            "        CHIP8_SetKeys(chip8, (uint16_t)(1u << (frame / 8 %% CHIP8_INPUTS)));\n"
+            "        CHIP8_DecreaseTimers(chip8);\n"
+            "\n"
+            "        if (translated) {\n"
+            "            %s_RunCycles(chip8, 1000);\n"
+            "        } else {\n"
+            "            CHIP8_RunCycles(chip8, 1000);\n"
+            "        }\n"
+            "    }\n"
+            "\n"
+            "    return NowSeconds() - start;\n"
+            "}\n"
+            "\n"
+            "int main(int argc, char** argv) {\n"
+            "    uint32_t cycles = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 50000000u;\n"
+            "\n"
+            "    CHIP8* native = CHIP8_Create();\n"
+            "    CHIP8* interpreted = CHIP8_Create();\n"
+            "\n"
+            "    if (native == NULL || interpreted == NULL || %s_Load(native) != 0 ||\n"
+            "        %s_Load(interpreted) != 0) {\n"
+            "        return 1;\n"
+            "    }\n"
+            "\n"
+            "    double nativeTime = Replay(native, cycles, true);\n"
+            "    double interpretedTime = Replay(interpreted, cycles, false);\n"
+            "\n"
+            "    CHIP_8GFX nativeGfx = CHIP8_GetGFX(native);\n"
+            "    CHIP_8GFX interpretedGfx = CHIP8_GetGFX(interpreted);\n"
+            "    bool same = memcmp(&nativeGfx, &interpretedGfx, sizeof(CHIP_8GFX)) == 0;\n"
+            "\n"
+            "    printf(\"aot %%.1f MIPS, interpreter %%.1f MIPS, %%.2fx, framebuffer %%s\\n\",\n"
+            "           cycles / nativeTime / 1e6, cycles / interpretedTime / 1e6,\n"
+            "           interpretedTime / nativeTime, same ? \"matches\" : \"DIFFERS\");\n"
+            "\n"
+            "    CHIP8_Destroy(native);\n"
+            "    CHIP8_Destroy(interpreted);\n"
+            "\n"
+            "    return same ? 0 : 2;\n"
+            "}\n",
+            name, name, name, name);
+}
+
+static void EmitProgram(FILE* out, const Program* program, const char* name, const char* romPath,
+                        bool withMain) {
+    fprintf(out,
+            "// Generated by chip8-aot from %s. Do not edit.\n"
+            "//\n"
+            "// Compile with include/chip8 and src/chip8 on the include path and link against\n"
+            "// libchip8.\n"
+            "\n"
+            "#include \"chip8_internal.h\"\n"
+            "#include <stdbool.h>\n"
+            "#include <stdint.h>\n"
+            "#include <string.h>\n"
+            "\n",
+            romPath);
+
+    fprintf(out, "static const uint8_t Rom[%zu] = {", program->size);
+    for (size_t i = 0; i < program->size; i++) {
+        fprintf(out, "%s0x%02X,", i % 12 == 0 ? "\n    " : " ", program->rom[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out,
+            "int %s_Load(CHIP8* chip8) { return CHIP8_LoadRom(chip8, Rom, sizeof(Rom)); }\n"
+            "\n"
+            "// A block only runs if all of its instructions fit in the cycles left and memory\n"
+            "// still holds the bytes it was translated from.\n"
+            "#define ENTER_BLOCK(address, count) \\\n"
+            "    if (remaining < (count) || \\\n"
+            "        memcmp(&chip8->memory[address], &Rom[(address) - CHIP8_PROGRAM_START], \\\n"
+            "               (count) * 2) != 0) { \\\n"
+            "        goto interpret; \\\n"
+            "    } \\\n"
+            "    remaining -= (count)\n"
+            "\n"
+            "void %s_RunCycles(CHIP8* chip8, uint32_t cycles) {\n"
+            "    uint32_t remaining = cycles;\n"
+            "\n"
+            "    for (;;) {\n"
+            "        switch (chip8->pc_counter) {\n",
+            name, name);
+
+    for (uint32_t address = 0; address < CHIP8_MEMORY_SIZE; address++) {
+        if (program->leader[address]) {
+            fprintf(out, "            case 0x%03X:\n                goto block_%03X;\n", address,
+                    address);
+        }
+    }
+
+    fprintf(out, "            default:\n"
+                 "                break;\n"
+                 "        }\n"
+                 "\n"
+                 "    interpret:\n"
+                 "        if (remaining == 0 || chip8->pc_counter + 1 >= CHIP8_MEMORY_SIZE) {\n"
+                 "            return;\n"
+                 "        }\n"
+                 "\n"
+                 "        CHIP8_RunTableDispatch(chip8, 1);\n"
+                 "        remaining -= 1;\n"
+                 "        continue;\n");
+
+    for (uint32_t address = 0; address < CHIP8_MEMORY_SIZE; address++) {
+        if (program->leader[address]) {
+            EmitBlock(out, program, (uint16_t)address);
+        }
+    }
+
+    fprintf(out, "    }\n}\n");
+
+    if (withMain) {
+        EmitMain(out, name);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* name = "chip8_aot";
+    bool withMain = false;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            name = argv[++arg];
+        } else if (strcmp(argv[arg], "-m") == 0) {
+            withMain = true;
+        } else {
+            break;
+        }
+    }
+
+    if (argc - arg != 2) {
+        fprintf(stderr, "usage: %s [-n name] [-m] rom out.c\n", argv[0]);
+        return 1;
+    }
+
+    static Program program;
+
+    FILE* romFile = fopen(argv[arg], "rb");
+    if (romFile == NULL) {
+        fprintf(stderr, "cannot open %s\n", argv[arg]);
+        return 1;
+    }
+
+    uint8_t overflow;
+    program.size = fread(program.rom, 1, sizeof(program.rom), romFile);
+    bool tooLarge = fread(&overflow, 1, 1, romFile) == 1;
+    fclose(romFile);
+
+    if (program.size == 0 || tooLarge) {
+        fprintf(stderr, "%s is empty or larger than %d bytes\n", argv[arg], CHIP8_MAX_ROM_SIZE);
+        return 1;
+    }
+
+    RecoverCode(&program);
+
+    FILE* out = fopen(argv[arg + 1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "cannot write %s\n", argv[arg + 1]);
+        return 1;
+    }
+
+    EmitProgram(out, &program, name, argv[arg], withMain);
+    fclose(out);
+
+    int blocks = 0;
+    int instructions = 0;
+    for (uint32_t address = 0; address < CHIP8_MEMORY_SIZE; address++) {
+        blocks += program.leader[address];
+        instructions += program.visited[address];
+    }
+
+    printf("%s: %d blocks, %d instructions recovered\n", argv[arg], blocks, instructions);
+
+    return 0;
+}
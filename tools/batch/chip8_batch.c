@@ -0,0 +1,592 @@
+// Runs a list of headless jobs over every core and writes one JSON object per job.
+//
+//   chip8-batch [-j threads] [-c cycles-per-frame] [-d dispatch] [-s seed] jobs.txt results.jsonl
+//
+// Each line of jobs.txt is one job, with tab-separated fields:
+//
+//   rom-path <TAB> frames [<TAB> input-script]
+//
+// where frames is a whole number from 1 up; any other value rejects the whole file.
+//
+// An input script holds "frame keymask" lines (keymask in hex, bit i = key i): from that frame on
+// the keypad is in that state. Blank lines and lines starting with '#' are ignored in both files.
+//
+// Jobs are dealt round-robin onto one deque per worker. A worker takes jobs from the back of its
+// own deque and, once that is empty, steals from the front of the others', so a few long jobs
+// can't leave the other cores idle. Every worker reuses one emulator instance for all its jobs.
+// Every job starts from the same CXNN seed, so results don't depend on which worker ran it or
+// what ran before it. Results are written in job order once everything has finished.
+
+#include "chip8.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define DEFAULT_CYCLES_PER_FRAME 10u
+#define DEFAULT_SEED 1u
+#define MAX_LINE 4096
+
+typedef struct KeyEvent {
+    uint32_t frame;
+    uint16_t keyMask;
+} KeyEvent;
+
+typedef struct Job {
+    char* romPath;
+    char* scriptPath;
+    uint32_t frames;
+
+    // Filled by the worker that ran it.
+    bool ok;
+    const char* error;
+    uint64_t frameHash;
+    uint64_t cycles;
+    double wallSeconds;
+    int worker;
+} Job;
+
+#if defined(_WIN32)
+typedef CRITICAL_SECTION Lock;
+static void LockInit(Lock* lock) { InitializeCriticalSection(lock); }
+static void LockAcquire(Lock* lock) { EnterCriticalSection(lock); }
+static void LockRelease(Lock* lock) { LeaveCriticalSection(lock); }
+static void LockDestroy(Lock* lock) { DeleteCriticalSection(lock); }
+#else
+typedef pthread_mutex_t Lock;
+static void LockInit(Lock* lock) { pthread_mutex_init(lock, NULL); }
+static void LockAcquire(Lock* lock) { pthread_mutex_lock(lock); }
+static void LockRelease(Lock* lock) { pthread_mutex_unlock(lock); }
+static void LockDestroy(Lock* lock) { pthread_mutex_destroy(lock); }
+#endif
+
+// Job indices; the owner pops from the back, thieves take from the front.
+typedef struct Deque {
+    Lock lock;
+    size_t* jobs;
+    size_t front;
+    size_t back;
+} Deque;
+
+typedef struct Batch {
+    Job* jobs;
+    size_t jobCount;
+
+    Deque* deques;
+    int workerCount;
+
+    uint32_t cyclesPerFrame;
+    uint32_t seed;
+    bool setDispatch;
+    CHIP8_DISPATCH dispatch;
+} Batch;
+
+typedef struct Worker {
+    Batch* batch;
+    int index;
+    size_t stolen;
+} Worker;
+
+static double NowSeconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static bool PopBack(Deque* deque, size_t* job) {
+    LockAcquire(&deque->lock);
+
+    bool found = deque->back > deque->front;
+    if (found) {
+        *job = deque->jobs[--deque->back];
+    }
+
+    LockRelease(&deque->lock);
+    return found;
+}
+
+static bool StealFront(Deque* deque, size_t* job) {
+    LockAcquire(&deque->lock);
+
+    bool found = deque->back > deque->front;
+    if (found) {
+        *job = deque->jobs[deque->front++];
+    }
+
+    LockRelease(&deque->lock);
+    return found;
+}
+
+static bool IsSkippedLine(const char* line) {
+    return line[0] == '\0' || line[0] == '\n' || line[0] == '\r' || line[0] == '#';
+}
+
+// Reads an input script into a frame-sorted array. Returns -1 if the file can't be read.
+static int LoadScript(const char* path, KeyEvent** events, size_t* count) {
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        return -1;
+    }
+
+    size_t capacity = 0;
+    char line[MAX_LINE];
+
+    *events = NULL;
+    *count = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long frame;
+        unsigned int keyMask;
+
+        if (IsSkippedLine(line) || sscanf(line, "%lu %x", &frame, &keyMask) != 2) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            KeyEvent* grown = (KeyEvent*)realloc(*events, capacity * sizeof(KeyEvent));
+
+            if (grown == NULL) {
+                fclose(file);
+                return -1;
+            }
+
+            *events = grown;
+        }
+
+        (*events)[(*count)++] = (KeyEvent){(uint32_t)frame, (uint16_t)keyMask};
+    }
+
+    fclose(file);
+
+    // Scripts are normally written in order already; insertion sort keeps them stable if not.
+    for (size_t i = 1; i < *count; i++) {
+        KeyEvent event = (*events)[i];
+        size_t j = i;
+
+        for (; j > 0 && (*events)[j - 1].frame > event.frame; j--) {
+            (*events)[j] = (*events)[j - 1];
+        }
+
+        (*events)[j] = event;
+    }
+
+    return 0;
+}
+
+// FNV-1a over the rows, so equal hashes mean equal screens across runs and machines.
+static uint64_t HashFrame(const CHIP_8GFX* gfx) {
+    uint64_t hash = 14695981039346656037ull;
+
+    for (int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            hash ^= (gfx->rows[y] >> shift) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    }
+
+    return hash;
+}
+
+static void RunJob(Batch* batch, CHIP8* chip8, Job* job) {
+    KeyEvent* events = NULL;
+    size_t eventCount = 0;
+
+    double start = NowSeconds();
+
+    if (CHIP8_LoadGameIntoMemory(chip8, job->romPath) != 0) {
+        job->error = "cannot load rom";
+        return;
+    }
+
+    CHIP8_SetRandomSeed(chip8, batch->seed);
+
+    if (job->scriptPath != NULL && LoadScript(job->scriptPath, &events, &eventCount) != 0) {
+        job->error = "cannot load input script";
+        free(events);
+        return;
+    }
+
+    size_t nextEvent = 0;
+
+    for (uint32_t frame = 0; frame < job->frames; frame++) {
+        while (nextEvent < eventCount && events[nextEvent].frame <= frame) {
+            CHIP8_SetKeys(chip8, events[nextEvent].keyMask);
+            nextEvent++;
+        }
+
+        CHIP8_DecreaseTimers(chip8);
+        CHIP8_RunCycles(chip8, batch->cyclesPerFrame);
+    }
+
+    job->frameHash = HashFrame(CHIP8_GetGFXView(chip8));
+    job->cycles = (uint64_t)job->frames * batch->cyclesPerFrame;
+    job->wallSeconds = NowSeconds() - start;
+    job->ok = true;
+
+    free(events);
+}
+
+static void RunWorker(Worker* worker) {
+    Batch* batch = worker->batch;
+    CHIP8* chip8 = CHIP8_Create();
+
+    if (chip8 == NULL) {
+        return;
+    }
+
+    if (batch->setDispatch) {
+        CHIP8_SetDispatch(chip8, batch->dispatch);
+    }
+
+    for (;;) {
+        size_t job;
+
+        if (!PopBack(&batch->deques[worker->index], &job)) {
+            bool stole = false;
+
+            for (int offset = 1; offset < batch->workerCount && !stole; offset++) {
+                int victim = (worker->index + offset) % batch->workerCount;
+                stole = StealFront(&batch->deques[victim], &job);
+            }
+
+            // Nobody adds jobs once the workers are running, so empty everywhere means done.
+            if (!stole) {
+                break;
+            }
+
+            worker->stolen += 1;
+        }
+
+        batch->jobs[job].worker = worker->index;
+        RunJob(batch, chip8, &batch->jobs[job]);
+    }
+
+    CHIP8_Destroy(chip8);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI WorkerThread(LPVOID argument) {
+    RunWorker((Worker*)argument);
+    return 0;
+}
+
+static int CpuCount() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+#else
+static void* WorkerThread(void* argument) {
+    RunWorker((Worker*)argument);
+    return NULL;
+}
+
+static int CpuCount() { return (int)sysconf(_SC_NPROCESSORS_ONLN); }
+#endif
+
+static void RunWorkers(Batch* batch, Worker* workers) {
+#if defined(_WIN32)
+    HANDLE* threads = (HANDLE*)calloc(batch->workerCount, sizeof(HANDLE));
+
+    // The calling thread is worker 0.
+    for (int i = 1; i < batch->workerCount; i++) {
+        threads[i] = CreateThread(NULL, 0, WorkerThread, &workers[i], 0, NULL);
+    }
+
+    RunWorker(&workers[0]);
+
+    for (int i = 1; i < batch->workerCount; i++) {
+        if (threads[i] != NULL) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+#else
+    pthread_t* threads = (pthread_t*)calloc(batch->workerCount, sizeof(pthread_t));
+    bool* started = (bool*)calloc(batch->workerCount, sizeof(bool));
+
+    // The calling thread is worker 0.
+    for (int i = 1; i < batch->workerCount; i++) {
+        started[i] = pthread_create(&threads[i], NULL, WorkerThread, &workers[i]) == 0;
+    }
+
+    RunWorker(&workers[0]);
+
+    for (int i = 1; i < batch->workerCount; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    free(started);
+#endif
+
+    free(threads);
+}
+
+static char* DuplicateString(const char* text) {
+    size_t length = strlen(text);
+    char* copy = (char*)malloc(length + 1);
+
+    if (copy != NULL) {
+        memcpy(copy, text, length + 1);
+    }
+
+    return copy;
+}
+
+// A whole decimal number from 1 to UINT32_MAX and nothing else. strtoul alone would take "-1",
+// "12abc" or "abc" and quietly give a huge count, 12 or 0.
+static bool ParseFrameCount(const char* text, uint32_t* frames) {
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long value = strtoul(text, &end, 10);
+
+    if (errno != 0 || *end != '\0' || value == 0 || value > UINT32_MAX) {
+        return false;
+    }
+
+    *frames = (uint32_t)value;
+    return true;
+}
+
+// Parses jobs.txt. Returns -1 on a read error or a malformed line.
+static int LoadJobs(const char* path, Job** jobs, size_t* count) {
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    char line[MAX_LINE];
+    int lineNumber = 0;
+
+    *jobs = NULL;
+    *count = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+
+        if (IsSkippedLine(line)) {
+            continue;
+        }
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char* rom = strtok(line, "\t");
+        char* frames = strtok(NULL, "\t");
+        char* script = strtok(NULL, "\t");
+
+        if (rom == NULL || frames == NULL) {
+            fprintf(stderr, "%s:%d: expected rom<TAB>frames[<TAB>script]\n", path, lineNumber);
+            fclose(file);
+            return -1;
+        }
+
+        uint32_t frameCount;
+
+        if (!ParseFrameCount(frames, &frameCount)) {
+            fprintf(stderr, "%s:%d: frames must be a whole number from 1 to %u, not \"%s\"\n", path,
+                    lineNumber, UINT32_MAX, frames);
+            fclose(file);
+            return -1;
+        }
+
+        if (*count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            Job* grown = (Job*)realloc(*jobs, capacity * sizeof(Job));
+
+            if (grown == NULL) {
+                fclose(file);
+                return -1;
+            }
+
+            *jobs = grown;
+        }
+
+        Job* job = &(*jobs)[(*count)++];
+        memset(job, 0, sizeof(Job));
+        job->romPath = DuplicateString(rom);
+        job->scriptPath = script != NULL ? DuplicateString(script) : NULL;
+        job->frames = frameCount;
+        job->worker = -1;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+static void WriteJsonString(FILE* out, const char* text) {
+    fputc('"', out);
+
+    for (const unsigned char* c = (const unsigned char*)text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+static void WriteResult(FILE* out, size_t index, const Job* job) {
+    fprintf(out, "{\"job\":%zu,\"rom\":", index);
+    WriteJsonString(out, job->romPath);
+
+    if (job->scriptPath != NULL) {
+        fprintf(out, ",\"script\":");
+        WriteJsonString(out, job->scriptPath);
+    }
+
+    fprintf(out, ",\"frames\":%lu", (unsigned long)job->frames);
+
+    if (job->ok) {
+        fprintf(out, ",\"cycles\":%llu,\"frame_hash\":\"%016llx\"", (unsigned long long)job->cycles,
+                (unsigned long long)job->frameHash);
+        fprintf(out, ",\"wall_ms\":%.3f,\"worker\":%d}\n", job->wallSeconds * 1e3, job->worker);
+    } else {
+        fprintf(out, ",\"error\":");
+        WriteJsonString(out, job->error != NULL ? job->error : "not run");
+        fprintf(out, "}\n");
+    }
+}
+
+static bool ParseDispatch(const char* name, CHIP8_DISPATCH* dispatch) {
+    static const struct {
+        const char* name;
+        CHIP8_DISPATCH dispatch;
+    } Names[] = {
+        {"table", CHIP8_DISPATCH_TABLE},
+        {"switch", CHIP8_DISPATCH_SWITCH},
+        {"threaded", CHIP8_DISPATCH_THREADED},
+        {"cached", CHIP8_DISPATCH_CACHED},
+        {"fused", CHIP8_DISPATCH_FUSED},
+        {"jit", CHIP8_DISPATCH_JIT},
+    };
+
+    for (size_t i = 0; i < sizeof(Names) / sizeof(Names[0]); i++) {
+        if (strcmp(name, Names[i].name) == 0) {
+            *dispatch = Names[i].dispatch;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv) {
+    Batch batch = {.cyclesPerFrame = DEFAULT_CYCLES_PER_FRAME, .seed = DEFAULT_SEED};
+    int threads = 0;
+    int arg = 1;
+
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        if (strcmp(argv[arg], "-j") == 0) {
+            threads = atoi(argv[arg + 1]);
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            batch.cyclesPerFrame = (uint32_t)strtoul(argv[arg + 1], NULL, 10);
+        } else if (strcmp(argv[arg], "-s") == 0) {
+            batch.seed = (uint32_t)strtoul(argv[arg + 1], NULL, 0);
+        } else if (strcmp(argv[arg], "-d") == 0 && ParseDispatch(argv[arg + 1], &batch.dispatch)) {
+            batch.setDispatch = true;
+        } else {
+            break;
+        }
+    }
+
+    if (argc - arg != 2) {
+        fprintf(stderr,
+                "usage: %s [-j threads] [-c cycles-per-frame] [-d dispatch] [-s seed] jobs.txt "
+                "results.jsonl\n",
+                argv[0]);
+        return 1;
+    }
+
+    if (LoadJobs(argv[arg], &batch.jobs, &batch.jobCount) != 0) {
+        return 1;
+    }
+
+    FILE* out = fopen(argv[arg + 1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "cannot write %s\n", argv[arg + 1]);
+        return 1;
+    }
+
+    batch.workerCount = threads > 0 ? threads : CpuCount();
+    if (batch.workerCount < 1) {
+        batch.workerCount = 1;
+    }
+
+    batch.deques = (Deque*)calloc(batch.workerCount, sizeof(Deque));
+    Worker* workers = (Worker*)calloc(batch.workerCount, sizeof(Worker));
+
+    for (int w = 0; w < batch.workerCount; w++) {
+        Deque* deque = &batch.deques[w];
+
+        LockInit(&deque->lock);
+        deque->jobs = (size_t*)malloc((batch.jobCount / batch.workerCount + 1) * sizeof(size_t));
+
+        for (size_t job = w; job < batch.jobCount; job += batch.workerCount) {
+            deque->jobs[deque->back++] = job;
+        }
+
+        workers[w] = (Worker){.batch = &batch, .index = w};
+    }
+
+    double start = NowSeconds();
+    RunWorkers(&batch, workers);
+    double elapsed = NowSeconds() - start;
+
+    uint64_t totalCycles = 0;
+    size_t failed = 0;
+    size_t stolen = 0;
+
+    for (size_t i = 0; i < batch.jobCount; i++) {
+        WriteResult(out, i, &batch.jobs[i]);
+        totalCycles += batch.jobs[i].cycles;
+        failed += !batch.jobs[i].ok;
+    }
+
+    fclose(out);
+
+    for (int w = 0; w < batch.workerCount; w++) {
+        stolen += workers[w].stolen;
+        LockDestroy(&batch.deques[w].lock);
+        free(batch.deques[w].jobs);
+    }
+
+    fprintf(stderr, "%zu jobs (%zu failed, %zu stolen) on %d threads in %.3f s, %.1f MIPS\n",
+            batch.jobCount, failed, stolen, batch.workerCount, elapsed,
+            elapsed > 0.0 ? totalCycles / elapsed / 1e6 : 0.0);
+
+    for (size_t i = 0; i < batch.jobCount; i++) {
+        free(batch.jobs[i].romPath);
+        free(batch.jobs[i].scriptPath);
+    }
+
+    free(batch.jobs);
+    free(batch.deques);
+    free(workers);
+
+    return failed == 0 ? 0 : 2;
+}
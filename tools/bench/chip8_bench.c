@@ -0,0 +1,314 @@
+// Headless interpreter benchmark: runs every ROM given on the command line through each dispatch
+// mode of libchip8 and prints emulated instructions per second, then each mode's speed relative
+// to the nested switch. With -l it also runs `lanes` copies of each ROM through the lockstep core,
+// once with every lane seeing the same keys and once with different keys per lane, and prints the
+// combined instructions per second of all lanes.
+// With -f it also plays `frames` frames of each ROM and prints the average time each screen filter
+// and each anti-flicker compositor mode takes on one frame, so they can be checked against the
+// 16.7 ms a 60 fps frame allows.
+//
+//   chip8-bench [-c cycles] [-l lanes] [-f frames] rom...
+
+#include "chip8.h"
+#include "compositor.h"
+#include "filter.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_CYCLES 50000000u
+// Timers tick and keys change once per "frame", like the real front end does.
+#define CYCLES_PER_FRAME 1000u
+
+typedef struct BenchMode {
+    const char* name;
+    CHIP8_DISPATCH dispatch;
+} BenchMode;
+
+static const BenchMode Modes[] = {
+    {"switch", CHIP8_DISPATCH_SWITCH},
+    {"table", CHIP8_DISPATCH_TABLE},
+    {"threaded", CHIP8_DISPATCH_THREADED},
+    {"cached", CHIP8_DISPATCH_CACHED},
+    {"fused", CHIP8_DISPATCH_FUSED},
+    {"jit", CHIP8_DISPATCH_JIT},
+};
+
+static double NowSeconds() {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static const char* FusionNames[CHIP8_FUSION_COUNT] = {
+    [CHIP8_FUSION_LOAD_PAIR] = "load-pair",
+    [CHIP8_FUSION_DRAW] = "draw",
+    [CHIP8_FUSION_DELAY_WAIT] = "delay-wait",
+    [CHIP8_FUSION_COUNTER_LOOP] = "counter-loop",
+};
+
+// Runs whole frames until at least `cycles` instructions are done; `instructions` receives how
+// many that was. fusionCounts receives CHIP8_GetFusionCount for every fusion before the instance
+// goes away.
+static double RunMode(const char* romPath, CHIP8_DISPATCH dispatch, uint32_t cycles,
+                      uint64_t* instructions, uint64_t* fusionCounts) {
+    CHIP8* chip8 = CHIP8_Create();
+
+    if (chip8 == NULL || CHIP8_LoadGameIntoMemory(chip8, romPath) != 0) {
+        CHIP8_Destroy(chip8);
+        return -1.0;
+    }
+
+    CHIP8_SetDispatch(chip8, dispatch);
+
+    double start = NowSeconds();
+    uint64_t done = 0;
+
+    for (uint32_t frame = 0; done < cycles; done += CYCLES_PER_FRAME, frame++) {
+        // Cycle through the keypad so ROMs waiting on FX0A/EX9E keep moving.
+        CHIP8_SetKeys(chip8, (uint16_t)(1u << (frame / 8 % CHIP8_INPUTS)));
+        CHIP8_DecreaseTimers(chip8);
+        CHIP8_RunCycles(chip8, CYCLES_PER_FRAME);
+    }
+
+    double elapsed = NowSeconds() - start;
+    *instructions = done;
+
+    for (int f = 0; f < CHIP8_FUSION_COUNT; f++) {
+        fusionCounts[f] = CHIP8_GetFusionCount(chip8, (CHIP8_FUSION)f);
+    }
+
+    CHIP8_Destroy(chip8);
+
+    return elapsed;
+}
+
+// Same frame loop as RunMode over every lane at once. With spreadKeys each lane is a few key
+// presses ahead of the previous one, so lanes diverge the way an input search does.
+static double RunLockstep(const char* romPath, size_t lanes, uint32_t cycles, bool spreadKeys) {
+    FILE* file = fopen(romPath, "rb");
+
+    if (file == NULL) {
+        return -1.0;
+    }
+
+    uint8_t romData[CHIP8_MAX_ROM_SIZE];
+    size_t romSize = fread(romData, 1, sizeof(romData), file);
+    fclose(file);
+
+    CHIP8_LOCKSTEP* lockstep = CHIP8_CreateLockstep(romData, romSize, lanes);
+
+    if (lockstep == NULL) {
+        return -1.0;
+    }
+
+    double start = NowSeconds();
+
+    for (uint32_t done = 0, frame = 0; done < cycles; done += CYCLES_PER_FRAME, frame++) {
+        for (size_t lane = 0; lane < lanes; lane++) {
+            uint32_t key = (frame / 8 + (spreadKeys ? (uint32_t)lane : 0)) % CHIP8_INPUTS;
+            CHIP8_SetLockstepKeys(lockstep, lane, (uint16_t)(1u << key));
+        }
+
+        CHIP8_DecreaseLockstepTimers(lockstep);
+        CHIP8_RunLockstepCycles(lockstep, CYCLES_PER_FRAME);
+    }
+
+    double elapsed = NowSeconds() - start;
+
+    CHIP8_DestroyLockstep(lockstep);
+
+    return elapsed;
+}
+
+// Read from every filtered or composited image, so the compiler can't drop work whose output is
+// never used.
+static volatile uint64_t ScreenSink;
+
+// Average seconds per frame of each filter and compositor mode over `frames` frames of the ROM.
+// Each frame goes through every filter and every mode in turn, so they all see the same screens.
+static bool RunScreenStages(const char* romPath, uint32_t frames, double* filterSeconds,
+                            double* compositeSeconds) {
+    CHIP8* chip8 = CHIP8_Create();
+
+    if (chip8 == NULL || CHIP8_LoadGameIntoMemory(chip8, romPath) != 0) {
+        CHIP8_Destroy(chip8);
+        return false;
+    }
+
+    static PackedImage image;
+    static Compositor compositors[COMPOSITE_MODE_COUNT];
+
+    memset(filterSeconds, 0, sizeof(double) * SCREEN_FILTER_COUNT);
+    memset(compositeSeconds, 0, sizeof(double) * COMPOSITE_MODE_COUNT);
+    memset(compositors, 0, sizeof(compositors));
+
+    for (int m = 0; m < COMPOSITE_MODE_COUNT; m++) {
+        SetCompositeMode(&compositors[m], (COMPOSITE_MODE)m);
+    }
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        CHIP8_SetKeys(chip8, (uint16_t)(1u << (frame / 8 % CHIP8_INPUTS)));
+        CHIP8_DecreaseTimers(chip8);
+        CHIP8_RunCycles(chip8, CYCLES_PER_FRAME);
+
+        const CHIP_8GFX* gfx = CHIP8_GetGFXView(chip8);
+
+        for (int f = 0; f < SCREEN_FILTER_COUNT; f++) {
+            double start = NowSeconds();
+            ApplyScreenFilter((SCREEN_FILTER)f, gfx, &image);
+            filterSeconds[f] += NowSeconds() - start;
+            ScreenSink += image.rows[frame % image.height][0];
+        }
+
+        uint64_t version = CHIP8_GetFramebufferVersion(chip8);
+
+        for (int m = 0; m < COMPOSITE_MODE_COUNT; m++) {
+            double start = NowSeconds();
+            PushCompositeFrame(&compositors[m], gfx, version);
+            compositeSeconds[m] += NowSeconds() - start;
+            ScreenSink += compositors[m].layers[0].rows[frame % CHIP8_SCREEN_HEIGHT];
+        }
+    }
+
+    CHIP8_Destroy(chip8);
+
+    for (int f = 0; f < SCREEN_FILTER_COUNT; f++) {
+        filterSeconds[f] /= frames;
+    }
+
+    for (int m = 0; m < COMPOSITE_MODE_COUNT; m++) {
+        compositeSeconds[m] /= frames;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t cycles = DEFAULT_CYCLES;
+    size_t lanes = 0;
+    uint32_t filterFrames = 0;
+    int firstRom = 1;
+
+    while (firstRom + 1 < argc && argv[firstRom][0] == '-') {
+        if (strcmp(argv[firstRom], "-c") == 0) {
+            cycles = (uint32_t)strtoul(argv[firstRom + 1], NULL, 10);
+        } else if (strcmp(argv[firstRom], "-l") == 0) {
+            lanes = (size_t)strtoul(argv[firstRom + 1], NULL, 10);
+        } else if (strcmp(argv[firstRom], "-f") == 0) {
+            filterFrames = (uint32_t)strtoul(argv[firstRom + 1], NULL, 10);
+        } else {
+            break;
+        }
+
+        firstRom += 2;
+    }
+
+    if (firstRom >= argc) {
+        fprintf(stderr, "usage: %s [-c cycles] [-l lanes] [-f frames] rom...\n", argv[0]);
+        return 1;
+    }
+
+    size_t modeCount = sizeof(Modes) / sizeof(Modes[0]);
+
+    printf("%-40s", "rom");
+    for (size_t m = 0; m < modeCount; m++) {
+        printf(" %12s", Modes[m].name);
+    }
+    printf("\n");
+
+    for (int r = firstRom; r < argc; r++) {
+        double mips[sizeof(Modes) / sizeof(Modes[0])];
+        uint64_t fusionCounts[CHIP8_FUSION_COUNT] = {0};
+
+        printf("%-40.40s", argv[r]);
+
+        for (size_t m = 0; m < modeCount; m++) {
+            uint64_t modeFusions[CHIP8_FUSION_COUNT] = {0};
+            uint64_t instructions = 0;
+            double elapsed =
+                RunMode(argv[r], Modes[m].dispatch, cycles, &instructions, modeFusions);
+
+            if (Modes[m].dispatch == CHIP8_DISPATCH_FUSED) {
+                memcpy(fusionCounts, modeFusions, sizeof(fusionCounts));
+            }
+
+            if (elapsed < 0.0) {
+                printf(" %12s", "load failed");
+                mips[m] = 0.0;
+                continue;
+            }
+
+            mips[m] = (double)instructions / elapsed / 1e6;
+            printf(" %7.1f MIPS", mips[m]);
+        }
+
+        printf("\n");
+
+        // Every mode against the switch baseline, the first one.
+        printf("  vs switch:");
+        for (size_t m = 1; m < modeCount; m++) {
+            printf(" %s %.2fx%s", Modes[m].name, mips[0] > 0.0 ? mips[m] / mips[0] : 0.0,
+                   m + 1 < modeCount ? "," : "");
+        }
+        printf("\n");
+
+        printf("  fused:");
+        for (int f = 0; f < CHIP8_FUSION_COUNT; f++) {
+            printf(" %s=%llu", FusionNames[f], (unsigned long long)fusionCounts[f]);
+        }
+        printf("\n");
+
+        if (filterFrames > 0) {
+            double filterSeconds[SCREEN_FILTER_COUNT];
+            double compositeSeconds[COMPOSITE_MODE_COUNT];
+
+            if (RunScreenStages(argv[r], filterFrames, filterSeconds, compositeSeconds)) {
+                printf("  filters:");
+                for (int f = 0; f < SCREEN_FILTER_COUNT; f++) {
+                    printf(" %s %.2f us%s", GetScreenFilterName((SCREEN_FILTER)f),
+                           filterSeconds[f] * 1e6, f + 1 < SCREEN_FILTER_COUNT ? "," : "");
+                }
+                printf("\n");
+
+                printf("  composite:");
+                for (int m = 0; m < COMPOSITE_MODE_COUNT; m++) {
+                    printf(" %s %.2f us%s", GetCompositeModeName((COMPOSITE_MODE)m),
+                           compositeSeconds[m] * 1e6, m + 1 < COMPOSITE_MODE_COUNT ? "," : "");
+                }
+                printf("\n");
+            } else {
+                printf("  filters: load failed\n");
+            }
+        }
+
+        if (lanes == 0) {
+            continue;
+        }
+
+        // About cycles / lanes instructions per lane, so the total work matches the other modes.
+        // Whole frames only, since that's how RunLockstep steps.
+        uint32_t laneCycles = (uint32_t)(cycles / lanes);
+        laneCycles = (laneCycles + CYCLES_PER_FRAME - 1) / CYCLES_PER_FRAME * CYCLES_PER_FRAME;
+        double instructions = (double)laneCycles * (double)lanes;
+        // RunLockstep returns a negative time when the ROM can't be loaded.
+        double sameMips = instructions / RunLockstep(argv[r], lanes, laneCycles, false) / 1e6;
+        double spreadMips = instructions / RunLockstep(argv[r], lanes, laneCycles, true) / 1e6;
+        // Against the table mode, the scalar loop a batch runner would use.
+        double tableMips = mips[1];
+
+        if (sameMips < 0.0 || spreadMips < 0.0) {
+            printf("  lockstep: load failed\n");
+            continue;
+        }
+
+        printf("  lockstep x%zu: same keys %.1f MIPS (%.2fx), per-lane keys %.1f MIPS (%.2fx)\n",
+               lanes, sameMips, tableMips > 0.0 ? sameMips / tableMips : 0.0, spreadMips,
+               tableMips > 0.0 ? spreadMips / tableMips : 0.0);
+    }
+
+    return 0;
+}